@@ -43,12 +43,17 @@
 #include <syslog.h>
 
 #include <climits>
+#include <cstring>
 #include <list>
 #include <map>
 #include <string>
+#include <vector>
 
 #include <devctl/guid.h>
+#include <devctl/string_view.h>
 #include <devctl/event.h>
+#include <devctl/event_arena.h>
+#include <devctl/event_clock.h>
 #include <devctl/event_factory.h>
 #include <devctl/consumer.h>
 #include <devctl/exception.h>
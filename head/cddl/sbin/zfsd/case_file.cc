@@ -53,12 +53,17 @@
 
 #include <libzfs.h>
 
+#include <cstring>
 #include <list>
 #include <map>
 #include <string>
+#include <vector>
 
 #include <devctl/guid.h>
+#include <devctl/string_view.h>
 #include <devctl/event.h>
+#include <devctl/event_arena.h>
+#include <devctl/event_clock.h>
 #include <devctl/event_factory.h>
 #include <devctl/exception.h>
 #include <devctl/consumer.h>
@@ -85,9 +90,11 @@ using std::setw;
 using DevCtl::Event;
 using DevCtl::EventBuffer;
 using DevCtl::EventFactory;
+using DevCtl::EventHandle;
 using DevCtl::EventList;
 using DevCtl::Guid;
 using DevCtl::ParseException;
+using DevCtl::StringView;
 
 /*-------------------------- File-scoped classes ----------------------------*/
 /**
@@ -367,7 +374,8 @@ CaseFile::ReEvaluate(const ZfsEvent &event)
 {
 	bool consumed(false);
 
-	if (event.Value("type") == "misc.fs.zfs.vdev_remove") {
+	switch (event.GetKind()) {
+	case ZfsEvent::VDEV_REMOVE:
 		/*
 		 * The Vdev we represent has been removed from the
 		 * configuration.  This case is no longer of value.
@@ -375,19 +383,18 @@ CaseFile::ReEvaluate(const ZfsEvent &event)
 		Close();
 
 		return (/*consumed*/true);
-	} else if (event.Value("type") == "misc.fs.zfs.pool_destroy") {
+	case ZfsEvent::POOL_DESTROY:
 		/* This Pool has been destroyed.  Discard the case */
 		Close();
 
 		return (/*consumed*/true);
-	} else if (event.Value("type") == "misc.fs.zfs.config_sync") {
+	case ZfsEvent::CONFIG_SYNC:
 		RefreshVdevState();
 		if (VdevState() < VDEV_STATE_HEALTHY)
 			consumed = ActivateSpare();
-	}
-
-
-	if (event.Value("class") == "resource.fs.zfs.removed") {
+		break;
+	case ZfsEvent::VDEV_REMOVED:
+	{
 		bool spare_activated;
 
 		if (!RefreshVdevState()) {
@@ -439,7 +446,9 @@ CaseFile::ReEvaluate(const ZfsEvent &event)
 		 * close the case
 		 */
 		consumed = spare_activated;
-	} else if (event.Value("class") == "resource.fs.zfs.statechange") {
+		break;
+	}
+	case ZfsEvent::VDEV_STATECHANGE:
 		RefreshVdevState();
 		/*
 		 * If this vdev is DEGRADED or FAULTED, try to activate a
@@ -449,13 +458,15 @@ CaseFile::ReEvaluate(const ZfsEvent &event)
 		    VdevState() == VDEV_STATE_DEGRADED)
 			(void) ActivateSpare();
 		consumed = true;
-	}
-	else if (event.Value("class") == "ereport.fs.zfs.io" ||
-	         event.Value("class") == "ereport.fs.zfs.checksum") {
-
-		m_tentativeEvents.push_front(event.DeepCopy());
+		break;
+	case ZfsEvent::IO_EREPORT:
+	case ZfsEvent::CHECKSUM_EREPORT:
+		m_tentativeEvents.push_front(event.Retain());
 		RegisterCallout(event);
 		consumed = true;
+		break;
+	default:
+		break;
 	}
 
 	bool closed(CloseIfSolved());
@@ -550,11 +561,17 @@ CaseFile::ActivateSpare() {
 void
 CaseFile::RegisterCallout(const Event &event)
 {
-	timeval now, countdown, elapsed, timestamp, zero, remaining;
+	timeval countdown, elapsed, zero, remaining;
+	timespec age;
 
-	gettimeofday(&now, 0);
-	timestamp = event.GetTimestamp();
-	timersub(&now, &timestamp, &elapsed);
+	/*
+	 * Measure the grace period from when the event was received,
+	 * using the monotonic clock, so that it is not stretched or cut
+	 * short by adjustments to the time of day.  Events restored from
+	 * a saved case file fall back to their wall clock timestamp.
+	 */
+	age = event.GetAge();
+	TIMESPEC_TO_TIMEVAL(&elapsed, &age);
 	timersub(&s_removeGracePeriod, &elapsed, &countdown);
 	/*
 	 * If countdown is <= zero, Reset the timer to the
@@ -777,37 +794,56 @@ CaseFile::~CaseFile()
 void
 CaseFile::PurgeEvents()
 {
-	for (EventList::iterator event(m_events.begin());
-	     event != m_events.end(); event++)
-		delete *event;
-
 	m_events.clear();
 }
 
 void
 CaseFile::PurgeTentativeEvents()
 {
-	for (EventList::iterator event(m_tentativeEvents.begin());
-	     event != m_tentativeEvents.end(); event++)
-		delete *event;
-
 	m_tentativeEvents.clear();
 }
 
 void
-CaseFile::SerializeEvList(const EventList events, int fd,
+CaseFile::SerializeEvList(const EventList &events, int fd,
 		const char* prefix) const
 {
 	if (events.empty())
 		return;
 	for (EventList::const_iterator curEvent = events.begin();
 	     curEvent != events.end(); curEvent++) {
-		const string &eventString((*curEvent)->GetEventString());
+		StringView eventString((*curEvent)->GetEventString());
+		StringView value;
+		char	   timestamp[64];
+		int	   timestampLen(0);
+
+		/*
+		 * The receive time of an event is not part of its event
+		 * string.  Save it as a trailing timestamp field, which
+		 * DeSerialize(), like that of older versions of zfsd,
+		 * parses as part of the event.
+		 */
+		if (!Event::PeekField(eventString, "timestamp", value)) {
+			try {
+				const timespec &ts((*curEvent)->GetTimestamp());
+
+				timestampLen = snprintf(timestamp,
+				    sizeof(timestamp), " timestamp=%jd.%09ld\n",
+				    (intmax_t)ts.tv_sec, (long)ts.tv_nsec);
+			} catch (const DevCtl::Exception &) {
+				/* Save the event as is. */
+			}
+		}
+		if (timestampLen > 0 && !eventString.empty()
+		 && eventString[eventString.length() - 1] == '\n')
+			eventString = eventString.substr(0,
+			    eventString.length() - 1);
 
 		// TODO: replace many write(2) calls with a single writev(2)
 		if (prefix)
 			write(fd, prefix, strlen(prefix));
-		write(fd, eventString.c_str(), eventString.length());
+		write(fd, eventString.data(), eventString.length());
+		if (timestampLen > 0)
+			write(fd, timestamp, timestampLen);
 	}
 }
 
@@ -875,7 +911,7 @@ CaseFile::DeSerialize(ifstream &caseStream)
 		}
 		Event *event(Event::CreateEvent(factory, line));
 		if (event != NULL) {
-			destEvents->push_back(event);
+			destEvents->push_back(EventHandle(event));
 			RegisterCallout(*event);
 		}
 	}
@@ -1093,16 +1129,22 @@ CaseFile::Replace(const char* vdev_type, const char* path, bool isspare) {
 
 /* Does the argument event refer to a checksum error? */
 static bool
-IsChecksumEvent(const Event* const event)
+IsChecksumEvent(const EventHandle &event)
 {
-	return ("ereport.fs.zfs.checksum" == event->Value("type"));
+	const ZfsEvent *zfsEvent(dynamic_cast<const ZfsEvent *>(event.Get()));
+
+	return (zfsEvent != NULL
+	     && zfsEvent->GetKind() == ZfsEvent::CHECKSUM_EREPORT);
 }
 
 /* Does the argument event refer to an IO error? */
 static bool
-IsIOEvent(const Event* const event)
+IsIOEvent(const EventHandle &event)
 {
-	return ("ereport.fs.zfs.io" == event->Value("type"));
+	const ZfsEvent *zfsEvent(dynamic_cast<const ZfsEvent *>(event.Get()));
+
+	return (zfsEvent != NULL
+	     && zfsEvent->GetKind() == ZfsEvent::IO_EREPORT);
 }
 
 bool
@@ -263,12 +263,12 @@ protected:
 	virtual bool RefreshVdevState();
 
 	/**
-	 * \brief Free all events in the m_events list.
+	 * \brief Release all events in the m_events list.
 	 */
 	void PurgeEvents();
 
 	/**
-	 * \brief Free all events in the m_tentativeEvents list.
+	 * \brief Release all events in the m_tentativeEvents list.
 	 */
 	void PurgeTentativeEvents();
 
@@ -287,10 +287,15 @@ protected:
 	/**
 	 * \brief Serializes the supplied event list and writes it to fd
 	 *
+	 * Each event is written on its own line as its event string.
+	 * Events whose string has no timestamp field are followed by a
+	 * " timestamp=<seconds>.<nanoseconds>" field recording the
+	 * event's timestamp.
+	 *
 	 * \param prefix  If not NULL, this prefix will be prepended to
 	 *                every event in the file.
 	 */
-	void SerializeEvList(const DevCtl::EventList events, int fd,
+	void SerializeEvList(const DevCtl::EventList &events, int fd,
 			     const char* prefix=NULL) const;
 
 	/**
@@ -0,0 +1,879 @@
+/*-
+ * Copyright (c) 2012, 2013 Spectra Logic Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions, and the following disclaimer,
+ *    without modification.
+ * 2. Redistributions in binary form must reproduce at minimum a disclaimer
+ *    substantially similar to the "NO WARRANTY" disclaimer below
+ *    ("Disclaimer") and any redistribution must be conditioned upon
+ *    including a substantially similar Disclaimer requirement for further
+ *    binary redistribution.
+ *
+ * NO WARRANTY
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTIBILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDERS OR CONTRIBUTORS BE LIABLE FOR SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGES.
+ *
+ * $FreeBSD$
+ */
+
+/**
+ * \file devctl_bench.cc
+ *
+ * Microbenchmarks for the event processing paths of libdevdctl.
+ *
+ * Each benchmark runs its workload several times and reports the
+ * time per event of the fastest run.  With no arguments every
+ * benchmark is run.  Otherwise only the named benchmarks are run.
+ */
+#include <sys/cdefs.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <list>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <devctl/guid.h>
+#include <devctl/string_view.h>
+#include <devctl/event.h>
+#include <devctl/event_arena.h>
+#include <devctl/event_clock.h>
+#include <devctl/event_buffer.h>
+#include <devctl/event_factory.h>
+#include <devctl/exception.h>
+#include <devctl/consumer.h>
+#include <devctl/reader.h>
+
+__FBSDID("$FreeBSD$");
+
+/*================================== Macros ==================================*/
+#define	NUM_ELEMENTS(x) (sizeof(x) / sizeof(*x))
+
+/*============================ Namespace Control =============================*/
+using std::string;
+using std::stringstream;
+
+using DevCtl::Consumer;
+using DevCtl::Event;
+using DevCtl::EventBuffer;
+using DevCtl::EventClock;
+using DevCtl::EventFactory;
+using DevCtl::EventList;
+using DevCtl::FDReader;
+using DevCtl::IstreamReader;
+using DevCtl::NVPairMap;
+using DevCtl::StringView;
+
+/*================================ Constants =================================*/
+/** The number of times each workload is run. */
+static const int NUM_RUNS = 5;
+
+/** A ZFS ereport, as received from devd. */
+static const char s_zfsEvent[] =
+    "!system=ZFS subsystem=ZFS type=ereport.fs.zfs.io "
+    "class=ereport.fs.zfs.io ena=1234567890 "
+    "pool_guid=9756779504028057996 pool_context=0 pool_failmode=wait "
+    "vdev_guid=1631193447431603339 vdev_type=disk vdev_path=/dev/da1 "
+    "parent_guid=123456 parent_type=raidz zio_err=5 zio_offset=25598976 "
+    "zio_size=131072 zio_objset=0 zio_object=0 zio_level=0 zio_blkid=0\n";
+
+/*============================ File Scoped Functions =========================*/
+/** \return  The time, in seconds, since an arbitrary fixed point. */
+static double
+Now()
+{
+	timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (ts.tv_sec + ts.tv_nsec / 1e9);
+}
+
+/**
+ * Print the result of a benchmark.
+ *
+ * \param name     The name of the benchmark.
+ * \param variant  The variant of the workload measured.
+ * \param seconds  The duration of the fastest run.
+ * \param events   The number of events processed by each run.
+ */
+static void
+Report(const char *name, const char *variant, double seconds, size_t events)
+{
+	printf("%-10s %-32s %9.1f ns/event\n", name, variant,
+	       seconds * 1e9 / events);
+}
+
+/**
+ * Print a per-event count measured by a benchmark.
+ *
+ * \param name     The name of the benchmark.
+ * \param variant  The variant of the workload measured.
+ * \param ratio    The count per event.
+ * \param units    What was counted.
+ */
+static void
+ReportRatio(const char *name, const char *variant, double ratio,
+	    const char *units)
+{
+	printf("%-10s %-32s %9.3f %s/event\n", name, variant, ratio, units);
+}
+
+/**
+ * \return  A string holding count copies of eventString.
+ */
+static string
+Repeat(const char *eventString, size_t count)
+{
+	string data;
+
+	data.reserve(strlen(eventString) * count);
+	while (count-- > 0)
+		data += eventString;
+	return (data);
+}
+
+/*------------------------------- EventClock ---------------------------------*/
+/**
+ * Stamp an event the way EventBuffer::ExtractEvent() did before
+ * EventClock: read the time of day and format a timestamp field with
+ * a stringstream, once per event.
+ *
+ * eturn  The length of the timestamp field, so that the work is not
+ *          optimized away.
+ */
+static size_t
+LegacyTimestamp()
+{
+	stringstream tsField;
+	timeval	     now;
+
+	gettimeofday(&now, NULL);
+	tsField << " timestamp=" << now.tv_sec;
+	return (tsField.str().size());
+}
+
+/**
+ * Extract events from an istream, stamping each one as ExtractEvent()
+ * used to and with each source of EventClock receive times.
+ */
+static bool
+BenchClock()
+{
+	const size_t	  numEvents(200000);
+	const string	  data(Repeat(s_zfsEvent, numEvents));
+	const char	 *variants[] = {
+		"ExtractEvent, legacy timestamp",
+		"ExtractEvent, precise clock",
+		"ExtractEvent, coarse clock"
+	};
+	EventClock::Source sources[] = {
+		EventClock::PRECISE, EventClock::PRECISE, EventClock::COARSE
+	};
+	size_t		  tsLen(0);
+
+	for (size_t i(0); i < NUM_ELEMENTS(sources); i++) {
+		bool   legacy(i == 0);
+		double best(0);
+
+		for (int run(0); run < NUM_RUNS; run++) {
+			std::istringstream stream(data);
+			IstreamReader	   reader(&stream);
+			EventBuffer	   buffer(reader, /*maxEventSize*/0,
+						  sources[i]);
+			StringView	   event;
+			double		   start(Now());
+
+			while (buffer.ExtractEvent(event)) {
+				if (legacy)
+					tsLen += LegacyTimestamp();
+				else
+					buffer.GetClock().ReceiveTime();
+			}
+
+			double elapsed(Now() - start);
+			if (run == 0 || elapsed < best)
+				best = elapsed;
+		}
+		Report("clock", variants[i], best, numEvents);
+	}
+	return (tsLen != 0);
+}
+
+/*--------------------------------- FDReader ---------------------------------*/
+/** An FDReader that counts the system calls made through it. */
+class CountingFDReader : public FDReader
+{
+public:
+	CountingFDReader(int fd, bool nonBlocking)
+	 : FDReader(fd, nonBlocking),
+	   m_calls(0)
+	{
+	}
+
+	virtual ssize_t in_avail() const
+	{
+		m_calls++;
+		return (FDReader::in_avail());
+	}
+
+	virtual ssize_t read(char *buf, size_t count)
+	{
+		m_calls++;
+		return (FDReader::read(buf, count));
+	}
+
+	/** The number of calls to in_avail() and read(). */
+	mutable size_t m_calls;
+};
+
+/**
+ * Extract events arriving on a stream socket in bursts, with a blocking
+ * FDReader that sizes its reads with FIONREAD and with a non-blocking
+ * FDReader that reads until EAGAIN.
+ */
+static bool
+BenchFDReader()
+{
+	const size_t burstEvents(64);
+	const size_t numBursts(20000);
+	const string burst(Repeat(s_zfsEvent, burstEvents));
+
+	for (int nonBlocking(0); nonBlocking < 2; nonBlocking++) {
+		double best(0);
+		double calls(0);
+
+		for (int run(0); run < NUM_RUNS; run++) {
+			int sockFD[2];
+			int bufSize(1024 * 1024);
+
+			if (socketpair(AF_UNIX, SOCK_STREAM, 0, sockFD) != 0) {
+				perror("socketpair");
+				return (false);
+			}
+			setsockopt(sockFD[0], SOL_SOCKET, SO_SNDBUF,
+				   &bufSize, sizeof(bufSize));
+			setsockopt(sockFD[1], SOL_SOCKET, SO_RCVBUF,
+				   &bufSize, sizeof(bufSize));
+
+			CountingFDReader reader(sockFD[1], nonBlocking != 0);
+			EventBuffer	 buffer(reader);
+			StringView	 event;
+			size_t		 extracted(0);
+			double		 elapsed(0);
+
+			for (size_t i(0); i < numBursts; i++) {
+				if (write(sockFD[0], burst.data(), burst.size())
+				 != (ssize_t)burst.size()) {
+					perror("write");
+					return (false);
+				}
+
+				double start(Now());
+				while (buffer.ExtractEvent(event))
+					extracted++;
+				elapsed += Now() - start;
+			}
+			close(sockFD[0]);
+			close(sockFD[1]);
+
+			if (extracted != burstEvents * numBursts) {
+				fprintf(stderr, "fdreader: extracted %zu of "
+					"%zu events\n", extracted,
+					burstEvents * numBursts);
+				return (false);
+			}
+			if (run == 0 || elapsed < best)
+				best = elapsed;
+			calls = (double)reader.m_calls / extracted;
+		}
+		const char *variant(nonBlocking ? "non-blocking, until EAGAIN"
+						: "blocking, FIONREAD sized");
+
+		Report("fdreader", variant, best, burstEvents * numBursts);
+		ReportRatio("fdreader", variant, calls, "calls");
+	}
+	return (true);
+}
+
+/*--------------------------------- Consumer ---------------------------------*/
+/**
+ * A Consumer of one end of a socketpair rather than of devd.  Events
+ * are parsed lazily, so that the cost of receiving them dominates.
+ */
+class SocketConsumer : public Consumer
+{
+public:
+	SocketConsumer(int sockFD)
+	 : Consumer(/*defBuilder*/&Event::Builder, /*regEntries*/NULL,
+		    /*numEntries*/0, EventClock::PRECISE, /*lazyParsing*/true)
+	{
+		m_devdSockFD = sockFD;
+	}
+};
+
+/**
+ * Receive bursts of devd records from a SOCK_SEQPACKET socket, one
+ * record per NextEvent() call and in batches with NextEvents().
+ */
+static bool
+BenchConsumer()
+{
+	const size_t burstEvents(64);
+	const size_t numBursts(20000);
+	const size_t eventLen(strlen(s_zfsEvent));
+
+	for (int batched(0); batched < 2; batched++) {
+		double best(0);
+
+		for (int run(0); run < NUM_RUNS; run++) {
+			int    sockFD[2];
+			int    bufSize(1024 * 1024);
+			size_t received(0);
+			double elapsed(0);
+
+			if (socketpair(AF_UNIX, SOCK_SEQPACKET, 0,
+				       sockFD) != 0) {
+				perror("socketpair");
+				return (false);
+			}
+			setsockopt(sockFD[0], SOL_SOCKET, SO_SNDBUF,
+				   &bufSize, sizeof(bufSize));
+			setsockopt(sockFD[1], SOL_SOCKET, SO_RCVBUF,
+				   &bufSize, sizeof(bufSize));
+			fcntl(sockFD[1], F_SETFL, O_NONBLOCK);
+
+			/* The consumer closes its end of the socket. */
+			SocketConsumer consumer(sockFD[1]);
+
+			for (size_t i(0); i < numBursts; i++) {
+				for (size_t j(0); j < burstEvents; j++)
+					write(sockFD[0], s_zfsEvent, eventLen);
+
+				double start(Now());
+				if (batched) {
+					EventList events;
+
+					consumer.NextEvents(events);
+					received += events.size();
+				} else {
+					Event *event;
+
+					while ((event = consumer.NextEvent())
+					    != NULL) {
+						received++;
+						delete event;
+					}
+				}
+				elapsed += Now() - start;
+			}
+			close(sockFD[0]);
+
+			if (received != burstEvents * numBursts) {
+				fprintf(stderr, "consumer: received %zu of %zu "
+					"events\n", received,
+					burstEvents * numBursts);
+				return (false);
+			}
+			if (run == 0 || elapsed < best)
+				best = elapsed;
+		}
+		Report("consumer", batched ? "NextEvents(), recvmmsg batches"
+					   : "NextEvent(), one recv each",
+		       best, burstEvents * numBursts);
+	}
+	return (true);
+}
+
+/*--------------------------------- Parsing ----------------------------------*/
+/**
+ * Build and destroy events from an ereport, parsing all of its fields
+ * and only its header fields.
+ */
+static bool
+BenchParse()
+{
+	const size_t numEvents(500000);
+	EventFactory factory(&Event::Builder);
+
+	for (int lazy(0); lazy < 2; lazy++) {
+		double best(0);
+
+		for (int run(0); run < NUM_RUNS; run++) {
+			double start(Now());
+
+			for (size_t i(0); i < numEvents; i++)
+				delete Event::CreateEventView(factory,
+				    s_zfsEvent, lazy != 0);
+
+			double elapsed(Now() - start);
+			if (run == 0 || elapsed < best)
+				best = elapsed;
+		}
+		Report("parse", lazy ? "CreateEventView(), lazy"
+				     : "CreateEventView()", best, numEvents);
+	}
+	return (true);
+}
+
+typedef std::map<string, string> FieldMap;
+
+/**
+ * A reference parser for the fields of an event string, written for
+ * clarity rather than speed.
+ *
+ * \param eventString  The event to parse.
+ * \param fields       Returns the fields of the event.
+ *
+ * \return  False if the event is malformed.  Otherwise true.
+ */
+static bool
+ReferenceParse(const string &eventString, FieldMap &fields)
+{
+	const char *separators(" \t\n");
+	size_t	    start;
+	size_t	    end;
+
+	switch (eventString[0]) {
+	case Event::ATTACH:
+	case Event::DETACH:
+		/* The device name immediately follows the event type. */
+		end = eventString.find_first_of(separators, 1);
+		if (end == string::npos)
+			return (false);
+		fields["device-name"] = eventString.substr(1, end - 1);
+		break;
+	case Event::NOTIFY:
+		break;
+	default:
+		return (false);
+	}
+
+	for (start = 1; start < eventString.length(); start = end + 1) {
+		string name;
+
+		end = eventString.find('=', start);
+		if (end == string::npos)
+			break;
+		start = eventString.find_last_of("! \t\n", end);
+		if (start == string::npos)
+			return (false);
+		start++;
+		name = eventString.substr(start, end - start);
+
+		start = end + 1;
+		if (start >= eventString.length())
+			return (false);
+		end = eventString.find_first_of(separators, start);
+		if (end == string::npos)
+			end = eventString.length() - 1;
+		fields[name] = eventString.substr(start, end - start);
+	}
+	if (fields.find("system") == fields.end())
+		fields["system"] = "none";
+	return (true);
+}
+
+/**
+ * Parse random event strings with CreateEventView() and with
+ * ReferenceParse(), and report any that they disagree on.
+ */
+static bool
+FuzzParse()
+{
+	const size_t numEvents(2000000);
+	const char   types[] = "!+-?x";
+	const char   alphabet[] = "ab=!  \t\nonx";
+	EventFactory factory(&Event::Builder);
+	size_t	     mismatches(0);
+	double	     start(Now());
+
+	srandom(1);
+	for (size_t i(0); i < numEvents; i++) {
+		string	 eventString(1, types[random() % strlen(types)]);
+		long	 length(random() % 24);
+		FieldMap expected;
+		FieldMap fields;
+		bool	 valid;
+		Event	*event;
+
+		while (length-- > 0)
+			eventString += alphabet[random() % strlen(alphabet)];
+		if (random() % 4 != 0)
+			eventString += '\n';
+
+		valid = ReferenceParse(eventString, expected);
+		event = Event::CreateEventView(factory, eventString);
+		if (event != NULL) {
+			const NVPairMap &map(event->GetMap());
+
+			for (NVPairMap::const_iterator field(map.begin());
+			     field != map.end(); field++)
+				fields[field->first.str()] =
+				    field->second.str();
+			delete event;
+		}
+
+		/*
+		 * The parent of ATTACH and DETACH events is parsed
+		 * separately from their fields, and the value of a
+		 * field at the very end of an unterminated event is
+		 * not compared.
+		 */
+		fields.erase("parent");
+		expected.erase("parent");
+		if ((event != NULL) != valid
+		 || (valid && strchr(" \t\n", *eventString.rbegin()) != NULL
+		  && fields != expected)) {
+			if (mismatches++ < 10)
+				fprintf(stderr, "parsefuzz: mismatch on "
+					"\"%s\"\n", eventString.c_str());
+		}
+	}
+	Report("parsefuzz", "CreateEventView(), random input",
+	       Now() - start, numEvents);
+	if (mismatches != 0)
+		fprintf(stderr, "parsefuzz: %zu mismatches\n", mismatches);
+	return (mismatches == 0);
+}
+
+/**
+ * Reject a flood of NOMATCH events, which are never built.
+ */
+static bool
+BenchNoMatch()
+{
+	const size_t numEvents(1000000);
+	const char   noMatch[] =
+	    "? at bus=0 slot=31 function=3 dbsf=pci0:0:31:3 "
+	    "handle=\\_SB_.PCI0.SBUS vendor=0x8086 device=0x1c22 "
+	    "subvendor=0x1028 subdevice=0x04aa class=0x0c0500 on pci0\n";
+	EventFactory factory(&Event::Builder);
+	double	     best(0);
+
+	for (int run(0); run < NUM_RUNS; run++) {
+		double start(Now());
+
+		for (size_t i(0); i < numEvents; i++) {
+			if (Event::CreateEventView(factory, noMatch) != NULL) {
+				fprintf(stderr, "nomatch: event built\n");
+				return (false);
+			}
+		}
+
+		double elapsed(Now() - start);
+		if (run == 0 || elapsed < best)
+			best = elapsed;
+	}
+	Report("nomatch", "CreateEventView()", best, numEvents);
+	return (true);
+}
+
+/*-------------------------------- Formatting --------------------------------*/
+/**
+ * Format an event for logging with a std::stringstream, as
+ * Event::ToString() once did.
+ */
+static string
+StreamFormat(const Event &event)
+{
+	const NVPairMap		 &map(event.GetMap());
+	NVPairMap::const_iterator deviceName(map.find("device-name"));
+	NVPairMap::const_iterator systemName(map.find("system"));
+	stringstream		  result;
+
+	if (deviceName != map.end())
+		result << deviceName->second << ": ";
+	if (systemName != map.end() && systemName->second != "none")
+		result << systemName->second << ": ";
+	result << Event::TypeToString(event.GetType()) << ' ';
+
+	for (NVPairMap::const_iterator field(map.begin());
+	     field != map.end(); field++) {
+		if (field == deviceName || field == systemName)
+			continue;
+		result << ' ' << field->first << '=' << field->second;
+	}
+	result << std::endl;
+	return (result.str());
+}
+
+/**
+ * Format an ereport for logging with a std::stringstream and into a
+ * stack buffer with Event::Format().
+ */
+static bool
+BenchFormat()
+{
+	const size_t numEvents(500000);
+	EventFactory factory(&Event::Builder);
+	Event	    *event(Event::CreateEvent(factory, s_zfsEvent));
+	char	     buf[Event::LOG_BUFFER_SIZE];
+	size_t	     length(0);
+
+	if (event == NULL) {
+		fprintf(stderr, "format: event not built\n");
+		return (false);
+	}
+
+	/* Both methods must produce the same text. */
+	if (event->Format(buf, sizeof(buf)) != StreamFormat(*event).length()
+	 || StreamFormat(*event) != buf) {
+		fprintf(stderr, "format: Format() output differs\n");
+		delete event;
+		return (false);
+	}
+
+	for (int useFormat(0); useFormat < 2; useFormat++) {
+		double best(0);
+
+		for (int run(0); run < NUM_RUNS; run++) {
+			double start(Now());
+
+			for (size_t i(0); i < numEvents; i++) {
+				if (useFormat)
+					length += event->Format(buf,
+								sizeof(buf));
+				else
+					length += StreamFormat(*event).length();
+			}
+
+			double elapsed(Now() - start);
+			if (run == 0 || elapsed < best)
+				best = elapsed;
+		}
+		Report("format", useFormat ? "Format()" : "std::stringstream",
+		       best, numEvents);
+	}
+	delete event;
+	return (length != 0);
+}
+
+/*------------------------------- EventFactory -------------------------------*/
+/** A registry like that of zfsd, plus handlers for other systems. */
+static EventFactory::Record s_registry[] = {
+	{ Event::NOTIFY, "ZFS",	  &Event::Builder },
+	{ Event::NOTIFY, "DEVFS", &Event::Builder },
+	{ Event::NOTIFY, "GEOM",  &Event::Builder },
+	{ Event::NOTIFY, "ACPI",  &Event::Builder },
+	{ Event::NOTIFY, "IFNET", &Event::Builder },
+	{ Event::NOTIFY, "CAM",	  &Event::Builder },
+	{ Event::ATTACH, "none",  &Event::Builder },
+	{ Event::DETACH, "none",  &Event::Builder }
+};
+
+/**
+ * Look up the build methods of NOTIFY events from a mix of registered
+ * and unregistered systems, in the Registry map and with
+ * EventFactory::Lookup().
+ */
+static bool
+BenchLookup()
+{
+	const size_t numLookups(20000000);
+	const char  *systems[] = {
+		"ZFS", "DEVFS", "GEOM", "ACPI", "USB", "CAM"
+	};
+	StringView   views[NUM_ELEMENTS(systems)];
+	EventFactory factory;
+	size_t	     expected(0);
+
+	factory.UpdateRegistry(s_registry, NUM_ELEMENTS(s_registry));
+	for (size_t i(0); i < NUM_ELEMENTS(systems); i++)
+		views[i] = systems[i];
+	for (size_t i(0); i < numLookups; i++)
+		if (strcmp(systems[i % NUM_ELEMENTS(systems)], "USB") != 0)
+			expected++;
+
+	for (int useLookup(0); useLookup < 2; useLookup++) {
+		const EventFactory::Registry &registry(factory.GetRegistry());
+		double			      best(0);
+
+		for (int run(0); run < NUM_RUNS; run++) {
+			size_t found(0);
+			double start(Now());
+
+			for (size_t i(0); i < numLookups; i++) {
+				const StringView &system(
+				    views[i % NUM_ELEMENTS(views)]);
+
+				if (useLookup) {
+					if (factory.Lookup(Event::NOTIFY,
+							   system) != NULL)
+						found++;
+				} else {
+					EventFactory::Key key(Event::NOTIFY,
+							      system.str());
+
+					if (registry.find(key)
+					 != registry.end())
+						found++;
+				}
+			}
+
+			double elapsed(Now() - start);
+			if (found != expected) {
+				fprintf(stderr, "lookup: found %zu of %zu\n",
+					found, expected);
+				return (false);
+			}
+			if (run == 0 || elapsed < best)
+				best = elapsed;
+		}
+		Report("lookup", useLookup ? "EventFactory::Lookup()"
+					   : "Registry::find()",
+		       best, numLookups);
+	}
+	return (true);
+}
+
+/**
+ * Simulate a rescan of GEOM providers, which builds a synthesized DEVFS
+ * CREATE event for each provider through Consumer::GetFactory().  The
+ * rescan is run with the factory shared by reference and with a copy
+ * of it made for each provider.
+ */
+static bool
+BenchRescan()
+{
+	const size_t	    numProviders(500);
+	const size_t	    numRescans(200);
+	std::vector<string> events;
+	Consumer	    consumer(/*defBuilder*/NULL, s_registry,
+				     NUM_ELEMENTS(s_registry));
+
+	for (size_t i(0); i < numProviders; i++) {
+		stringstream event;
+
+		event << "!system=DEVFS subsystem=CDEV type=CREATE "
+			 "sub_type=synthesized cdev=da" << i << "\n";
+		events.push_back(event.str());
+	}
+
+	for (int byReference(0); byReference < 2; byReference++) {
+		double best(0);
+
+		for (int run(0); run < NUM_RUNS; run++) {
+			size_t built(0);
+			double start(Now());
+
+			for (size_t rescan(0); rescan < numRescans; rescan++) {
+				for (size_t i(0); i < numProviders; i++) {
+					Event *event;
+
+					if (byReference) {
+						event = Event::CreateEventView(
+						    consumer.GetFactory(),
+						    events[i]);
+					} else {
+						EventFactory factory(
+						    consumer.GetFactory());
+
+						event = Event::CreateEventView(
+						    factory, events[i]);
+					}
+					if (event != NULL)
+						built++;
+					delete event;
+				}
+			}
+
+			double elapsed(Now() - start);
+			if (built != numProviders * numRescans) {
+				fprintf(stderr, "rescan: built %zu of %zu "
+					"events\n", built,
+					numProviders * numRescans);
+				return (false);
+			}
+			if (run == 0 || elapsed < best)
+				best = elapsed;
+		}
+		Report("rescan", byReference ? "factory by reference"
+					     : "factory copied per provider",
+		       best, numProviders * numRescans);
+	}
+	return (true);
+}
+
+/*================================ Benchmarks ================================*/
+/** A named benchmark. */
+struct Benchmark
+{
+	const char *m_name;
+
+	/** Run the benchmark.  Returns false if it detected a fault. */
+	bool	  (*m_run)();
+};
+
+static const Benchmark s_benchmarks[] = {
+	{ "clock",	&BenchClock },
+	{ "fdreader",	&BenchFDReader },
+	{ "consumer",	&BenchConsumer },
+	{ "parse",	&BenchParse },
+	{ "parsefuzz",	&FuzzParse },
+	{ "nomatch",	&BenchNoMatch },
+	{ "format",	&BenchFormat },
+	{ "lookup",	&BenchLookup },
+	{ "rescan",	&BenchRescan }
+};
+
+static void
+Usage()
+{
+	fprintf(stderr, "usage: devctl_bench [benchmark ...]\n");
+	fprintf(stderr, "benchmarks:");
+	for (size_t i(0); i < NUM_ELEMENTS(s_benchmarks); i++)
+		fprintf(stderr, " %s", s_benchmarks[i].m_name);
+	fprintf(stderr, "\n");
+	exit(1);
+}
+
+int
+main(int argc, char **argv)
+{
+	bool ok(true);
+
+	for (int arg(1); arg < argc; arg++) {
+		size_t i(0);
+
+		while (i < NUM_ELEMENTS(s_benchmarks)
+		    && strcmp(argv[arg], s_benchmarks[i].m_name) != 0)
+			i++;
+		if (i == NUM_ELEMENTS(s_benchmarks))
+			Usage();
+	}
+
+	for (size_t i(0); i < NUM_ELEMENTS(s_benchmarks); i++) {
+		bool selected(argc == 1);
+
+		for (int arg(1); arg < argc; arg++)
+			if (strcmp(argv[arg], s_benchmarks[i].m_name) == 0)
+				selected = true;
+		if (selected && !s_benchmarks[i].m_run())
+			ok = false;
+	}
+	return (ok ? 0 : 1);
+}
@@ -30,26 +30,38 @@
  * Authors: Alan Somers         (Spectra Logic Corporation)
  */
 #include <sys/cdefs.h>
+#include <sys/socket.h>
+#include <sys/time.h>
 
+#include <fcntl.h>
 #include <stdarg.h>
+#include <stdlib.h>
 #include <syslog.h>
+#include <unistd.h>
 
 #include <libnvpair.h>
 #include <libzfs.h>
 
+#include <cstring>
 #include <list>
 #include <map>
 #include <sstream>
 #include <string>
+#include <vector>
 
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
 
 #include <devctl/guid.h>
+#include <devctl/string_view.h>
 #include <devctl/event.h>
+#include <devctl/event_arena.h>
+#include <devctl/event_clock.h>
+#include <devctl/event_buffer.h>
 #include <devctl/event_factory.h>
 #include <devctl/exception.h>
 #include <devctl/consumer.h>
+#include <devctl/reader.h>
 
 #include <zfsd/callout.h>
 #include <zfsd/vdev_iterator.h>
@@ -72,11 +84,22 @@ using std::string;
 using std::stringstream;
 
 using DevCtl::Event;
+using DevCtl::EventArena;
 using DevCtl::EventBuffer;
+using DevCtl::EventClock;
 using DevCtl::EventFactory;
+using DevCtl::EventHandle;
 using DevCtl::EventList;
+using DevCtl::FDReader;
 using DevCtl::Guid;
+using DevCtl::IstreamReader;
+using DevCtl::KEY_CLASS;
+using DevCtl::KEY_SUBSYSTEM;
+using DevCtl::KEY_SYSTEM;
+using DevCtl::KEY_TYPE;
+using DevCtl::MmapReader;
 using DevCtl::NVPairMap;
+using DevCtl::StringView;
 
 /* redefine zpool_handle here because libzfs_impl.h is not includable */
 struct zpool_handle
@@ -95,7 +118,7 @@ struct zpool_handle
 class MockZfsEvent : public ZfsEvent
 {
 public:
-	MockZfsEvent(Event::Type, NVPairMap&, const string&);
+	MockZfsEvent(Event::Type, NVPairMap&, const StringView&);
 	virtual ~MockZfsEvent() {}
 
 	static BuildMethod MockZfsEventBuilder;
@@ -111,7 +134,7 @@ EventFactory::Record MockZfsEvent::s_buildRecords[] =
 };
 
 MockZfsEvent::MockZfsEvent(Event::Type type, NVPairMap& map,
-			   const string& str)
+			   const StringView& str)
  : ZfsEvent(type, map, str)
 {
 }
@@ -119,7 +142,7 @@ MockZfsEvent::MockZfsEvent(Event::Type type, NVPairMap& map,
 Event *
 MockZfsEvent::MockZfsEventBuilder(Event::Type type,
 				  NVPairMap &nvpairs,
-			  	  const string &eventString)
+			  	  const StringView &eventString)
 {
 	return (new MockZfsEvent(type, nvpairs, eventString));
 }
@@ -413,6 +436,900 @@ TEST_F(ZfsEventTest, ProcessPoolEventGetsCalled)
 	mock_event->Process();
 }
 
+/*
+ * An event created from a view references the caller's data, while a deep
+ * copy of it owns its own event string
+ */
+TEST_F(ZfsEventTest, EventViewDeepCopy)
+{
+	string evString("!system=ZFS "
+			"subsystem=ZFS "
+			"type=misc.fs.zfs.vdev_remove "
+			"pool_name=foo "
+			"pool_guid=9756779504028057996 "
+			"vdev_guid=1631193447431603339 "
+			"timestamp=1348871594\n");
+	m_event = Event::CreateEventView(*m_eventFactory, evString);
+	ASSERT_NE((Event*)NULL, m_event);
+	EXPECT_EQ(evString.data(), m_event->GetEventString().data());
+
+	Event *copy(m_event->DeepCopy());
+	EXPECT_NE(evString.data(), copy->GetEventString().data());
+	evString.replace(0, evString.length(), evString.length(), 'x');
+	EXPECT_EQ(string("foo"), copy->Value("pool_name"));
+	EXPECT_EQ((size_t)0, copy->GetEventString().find("!system=ZFS "));
+	delete copy;
+}
+
+/*
+ * Retaining a view copies it once.  Retaining an event that owns its
+ * event string shares it.
+ */
+TEST_F(ZfsEventTest, EventRetain)
+{
+	string evString("!system=ZFS "
+			"subsystem=ZFS "
+			"type=misc.fs.zfs.vdev_remove "
+			"pool_name=foo "
+			"pool_guid=9756779504028057996 "
+			"vdev_guid=1631193447431603339\n");
+	m_event = Event::CreateEventView(*m_eventFactory, evString);
+	ASSERT_NE((Event*)NULL, m_event);
+
+	EventHandle first(m_event->Retain());
+	EventHandle second(m_event->Retain());
+	EventHandle third(first->Retain());
+	EXPECT_NE((const Event*)m_event, first.Get());
+	EXPECT_EQ(first.Get(), second.Get());
+	EXPECT_EQ(first.Get(), third.Get());
+	EXPECT_NE(evString.data(), first->GetEventString().data());
+
+	/* The retained copy outlives the view. */
+	delete m_event;
+	m_event = NULL;
+	evString.replace(0, evString.length(), evString.length(), 'x');
+	EXPECT_EQ(string("foo"), third->Value("pool_name"));
+}
+
+/*
+ * Event fields are iterated in name order, and a repeated name takes the
+ * last value given for it
+ */
+TEST_F(ZfsEventTest, EventFieldOrder)
+{
+	string evString("!system=ZFS "
+			"subsystem=ZFS "
+			"type=misc.fs.zfs.vdev_remove "
+			"pool_name=foo "
+			"pool_name=bar "
+			"pool_guid=9756779504028057996 "
+			"vdev_guid=1631193447431603339 "
+			"timestamp=1348871594\n");
+	m_event = Event::CreateEvent(*m_eventFactory, evString);
+	ASSERT_NE((Event*)NULL, m_event);
+	EXPECT_EQ(string("bar"), m_event->Value("pool_name"));
+	EXPECT_FALSE(m_event->Contains(string("pool")));
+
+	const NVPairMap &nvpairs(m_event->GetMap());
+	NVPairMap::const_iterator field(nvpairs.begin());
+	ASSERT_EQ((size_t)7, nvpairs.size());
+	EXPECT_EQ(string("pool_guid"), field->first);
+	EXPECT_EQ(string("pool_name"), (++field)->first);
+	EXPECT_EQ(string("subsystem"), (++field)->first);
+	EXPECT_EQ(string("system"), (++field)->first);
+	EXPECT_EQ(string("timestamp"), (++field)->first);
+	EXPECT_EQ(string("type"), (++field)->first);
+	EXPECT_EQ(string("vdev_guid"), (++field)->first);
+	EXPECT_TRUE(++field == nvpairs.end());
+}
+
+/*
+ * Well known fields are available by key, already converted where a typed
+ * accessor exists
+ */
+TEST_F(ZfsEventTest, EventWellKnownKeys)
+{
+	string evString("!system=ZFS "
+			"subsystem=foo "
+			"type=misc.fs.zfs.vdev_remove "
+			"pool_guid=9756779504028057996 "
+			"vdev_guid=1631193447431603339 "
+			"timestamp=1348871594\n");
+	m_event = Event::CreateEvent(*m_eventFactory, evString);
+	ASSERT_NE((Event*)NULL, m_event);
+	ZfsEvent *zfs_event(static_cast<ZfsEvent*>(m_event));
+
+	EXPECT_EQ(string("misc.fs.zfs.vdev_remove"), m_event->Value(KEY_TYPE));
+	EXPECT_EQ(string("foo"), m_event->Value(KEY_SUBSYSTEM));
+	EXPECT_FALSE(m_event->Contains(KEY_CLASS));
+	EXPECT_TRUE(m_event->Value(KEY_CLASS).empty());
+	EXPECT_EQ(Guid(9756779504028057996ULL), zfs_event->PoolGUID());
+	EXPECT_EQ(Guid(1631193447431603339ULL), zfs_event->VdevGUID());
+	EXPECT_EQ(1348871594, m_event->GetTimestamp().tv_sec);
+}
+
+/*
+ * The final field of an event string is complete even when no newline
+ * terminates the string, as is the case for events read from case files
+ */
+TEST_F(ZfsEventTest, EventUnterminatedFinalField)
+{
+	string evString("!system=ZFS "
+			"subsystem=ZFS "
+			"type=misc.fs.zfs.vdev_remove "
+			"pool_guid=9756779504028057996 "
+			"vdev_guid=1631193447431603339");
+	m_event = Event::CreateEvent(*m_eventFactory, evString);
+	ASSERT_NE((Event*)NULL, m_event);
+	EXPECT_EQ(Guid(1631193447431603339ULL),
+		  static_cast<ZfsEvent*>(m_event)->VdevGUID());
+}
+
+/*
+ * A lazily parsed view answers routing queries from its header and
+ * parses the remaining fields on first access
+ */
+TEST_F(ZfsEventTest, EventLazyView)
+{
+	string evString("!system=DEVFS "
+			"subsystem=CDEV "
+			"type=CREATE "
+			"cdev=da5 "
+			"timestamp=1348871594\n");
+	EventFactory devfsFactory(Event::Builder);
+	uint64_t unparsed(Event::UnparsedEventCount());
+
+	m_event = Event::CreateEventView(devfsFactory, evString,
+					 /*lazy*/true);
+	ASSERT_NE((Event*)NULL, m_event);
+	EXPECT_EQ(string("CREATE"), m_event->Value(KEY_TYPE));
+	EXPECT_FALSE(m_event->GetMap().empty());
+	EXPECT_EQ(string("da5"), m_event->Value("cdev"));
+	EXPECT_EQ(1348871594, m_event->GetTimestamp().tv_sec);
+	delete m_event;
+	m_event = NULL;
+	EXPECT_EQ(unparsed, Event::UnparsedEventCount());
+
+	/* Discarded without being examined */
+	m_event = Event::CreateEventView(devfsFactory, evString,
+					 /*lazy*/true);
+	ASSERT_NE((Event*)NULL, m_event);
+	delete m_event;
+	m_event = NULL;
+	EXPECT_EQ(unparsed + 1, Event::UnparsedEventCount());
+
+	/* Retained without being examined, counted once */
+	m_event = Event::CreateEventView(devfsFactory, evString,
+					 /*lazy*/true);
+	ASSERT_NE((Event*)NULL, m_event);
+	{
+		EventHandle retained(m_event->Retain());
+
+		delete m_event;
+		m_event = NULL;
+	}
+	EXPECT_EQ(unparsed + 2, Event::UnparsedEventCount());
+}
+
+/*
+ * Fractional timestamps keep their sub-second part.  Received events
+ * without a timestamp field are stamped with their receive time, which
+ * copies retain, and their event data is left untouched.
+ */
+TEST_F(ZfsEventTest, EventTimestamp)
+{
+	string evString("!system=DEVFS "
+			"subsystem=CDEV "
+			"type=CREATE "
+			"cdev=da5 "
+			"timestamp=1348871594.25\n");
+	string unstamped("!system=DEVFS "
+			 "subsystem=CDEV "
+			 "type=CREATE "
+			 "cdev=da5\n");
+	EventFactory devfsFactory(Event::Builder);
+	EventClock clock;
+
+	m_event = Event::CreateEventView(devfsFactory, evString,
+					 /*lazy*/false, /*arena*/NULL, &clock);
+	ASSERT_NE((Event*)NULL, m_event);
+	EXPECT_EQ(1348871594, m_event->GetTimestamp().tv_sec);
+	EXPECT_EQ(250000000, m_event->GetTimestamp().tv_nsec);
+	ASSERT_TRUE(m_event->HasReceiveTime());
+	EXPECT_EQ(clock.ReceiveTime().tv_sec,
+		  m_event->GetReceiveTime().tv_sec);
+	EXPECT_EQ(clock.ReceiveTime().tv_nsec,
+		  m_event->GetReceiveTime().tv_nsec);
+	delete m_event;
+
+	m_event = Event::CreateEventView(devfsFactory, unstamped,
+					 /*lazy*/false, /*arena*/NULL, &clock);
+	ASSERT_NE((Event*)NULL, m_event);
+	EXPECT_EQ(unstamped, m_event->GetEventString());
+	EXPECT_FALSE(m_event->Contains(DevCtl::KEY_TIMESTAMP));
+	EXPECT_EQ(clock.Now().tv_sec, m_event->GetTimestamp().tv_sec);
+	EXPECT_EQ(clock.Now().tv_nsec, m_event->GetTimestamp().tv_nsec);
+
+	EventHandle copy(m_event->Retain());
+	EXPECT_TRUE(copy->HasReceiveTime());
+	EXPECT_EQ(clock.Now().tv_sec, copy->GetTimestamp().tv_sec);
+
+	/* Events without a receive time age by the wall clock. */
+	Event *created(Event::CreateEvent(devfsFactory, unstamped));
+	ASSERT_NE((Event*)NULL, created);
+	EXPECT_FALSE(created->HasReceiveTime());
+	EXPECT_THROW(created->GetTimestamp(), DevCtl::Exception);
+	created->SetTimestamp(m_event->GetTimestamp());
+	EXPECT_EQ(clock.Now().tv_sec, created->GetTimestamp().tv_sec);
+	delete created;
+}
+
+/*
+ * Format() produces the same text as ToString() without allocating,
+ * truncating to the buffer supplied.
+ */
+TEST_F(ZfsEventTest, EventFormat)
+{
+	string evString("+da3 at bus=0 target=1 lun=2 on ahcich0\n");
+	EventFactory factory(Event::Builder);
+	char buf[Event::LOG_BUFFER_SIZE];
+	char small[8];
+
+	m_event = Event::CreateEvent(factory, evString);
+	ASSERT_NE((Event*)NULL, m_event);
+
+	string expected(m_event->ToString());
+	EXPECT_EQ(string("da3: Attach  bus=0 lun=2 parent=ahcich0 target=1\n"),
+		  expected);
+	EXPECT_EQ(expected.length(), m_event->Format(buf, sizeof(buf)));
+	EXPECT_EQ(expected, string(buf));
+
+	EXPECT_EQ(expected.length(), m_event->Format(small, sizeof(small)));
+	EXPECT_EQ(expected.substr(0, sizeof(small) - 1), string(small));
+}
+
+/*
+ * Once an arena has grown to fit an event, building further events from
+ * it allocates nothing from the heap.  Retained events leave the arena.
+ */
+TEST_F(ZfsEventTest, EventArena)
+{
+	string evString("!system=ZFS "
+			"subsystem=ZFS "
+			"type=misc.fs.zfs.vdev_remove "
+			"pool_name=foo "
+			"pool_guid=9756779504028057996 "
+			"vdev_guid=1631193447431603339\n");
+	EventArena arena;
+	uint64_t heapAllocations(0);
+	uint64_t chunkAllocations(0);
+
+	for (int i(0); i < 3; i++) {
+		m_event = Event::CreateEventView(*m_eventFactory, evString,
+						 /*lazy*/false, &arena);
+		ASSERT_NE((Event*)NULL, m_event);
+		EXPECT_EQ(string("foo"), m_event->Value("pool_name"));
+		delete m_event;
+		m_event = NULL;
+		EXPECT_EQ((size_t)0, arena.LiveAllocations());
+		if (i == 0) {
+			heapAllocations = EventArena::HeapAllocations();
+			chunkAllocations = arena.ChunkAllocations();
+		}
+	}
+	EXPECT_EQ(heapAllocations, EventArena::HeapAllocations());
+	EXPECT_EQ(chunkAllocations, arena.ChunkAllocations());
+
+	m_event = Event::CreateEventView(*m_eventFactory, evString,
+					 /*lazy*/false, &arena);
+	ASSERT_NE((Event*)NULL, m_event);
+	EventHandle retained(m_event->Retain());
+	delete m_event;
+	m_event = NULL;
+	EXPECT_EQ((size_t)0, arena.LiveAllocations());
+	EXPECT_EQ(string("foo"), retained->Value("pool_name"));
+}
+
+/* A build method that fails, as one may when an event is malformed. */
+static Event *
+FailingBuilder(Event::Type, NVPairMap &, const StringView &)
+{
+	throw DevCtl::Exception("build failed");
+}
+
+/*
+ * A build method that throws leaves nothing allocated from the arena
+ */
+TEST(EventTest, EventArenaBuildFailure)
+{
+	EventFactory factory(FailingBuilder);
+	EventArena   arena;
+	bool	     thrown(false);
+
+	try {
+		Event::CreateEventView(factory, "!system=ZFS type=x\n",
+				       /*lazy*/false, &arena);
+	} catch (const DevCtl::Exception &) {
+		thrown = true;
+	}
+	EXPECT_TRUE(thrown);
+	EXPECT_EQ((size_t)0, arena.LiveAllocations());
+}
+
+/*
+ * ZFS events are classified by type, or by class when the type is unknown
+ */
+TEST_F(ZfsEventTest, EventKind)
+{
+	EXPECT_EQ(ZfsEvent::CONFIG_SYNC,
+		  ZfsEvent::Classify("misc.fs.zfs.config_sync"));
+	EXPECT_EQ(ZfsEvent::POOL_DESTROY,
+		  ZfsEvent::Classify("misc.fs.zfs.pool_destroy"));
+	EXPECT_EQ(ZfsEvent::RESILVER_FINISH,
+		  ZfsEvent::Classify("misc.fs.zfs.resilver_finish"));
+	EXPECT_EQ(ZfsEvent::VDEV_REMOVE,
+		  ZfsEvent::Classify("misc.fs.zfs.vdev_remove"));
+	EXPECT_EQ(ZfsEvent::OTHER_POOL_EVENT,
+		  ZfsEvent::Classify("misc.fs.zfs.scrub_start"));
+	EXPECT_EQ(ZfsEvent::VDEV_REMOVED,
+		  ZfsEvent::Classify("resource.fs.zfs.removed"));
+	EXPECT_EQ(ZfsEvent::VDEV_STATECHANGE,
+		  ZfsEvent::Classify("resource.fs.zfs.statechange"));
+	EXPECT_EQ(ZfsEvent::IO_EREPORT,
+		  ZfsEvent::Classify("ereport.fs.zfs.io"));
+	EXPECT_EQ(ZfsEvent::CHECKSUM_EREPORT,
+		  ZfsEvent::Classify("ereport.fs.zfs.checksum"));
+	EXPECT_EQ(ZfsEvent::NO_REPLICAS_EREPORT,
+		  ZfsEvent::Classify("ereport.fs.zfs.vdev.no_replicas"));
+	EXPECT_EQ(ZfsEvent::UNKNOWN_KIND,
+		  ZfsEvent::Classify("ereport.fs.zfs.probe_failure"));
+	EXPECT_EQ(ZfsEvent::UNKNOWN_KIND, ZfsEvent::Classify(""));
+
+	string evString("!system=ZFS "
+			"subsystem=ZFS "
+			"type=foo "
+			"class=resource.fs.zfs.statechange "
+			"pool_guid=9756779504028057996 "
+			"vdev_guid=1631193447431603339\n");
+	m_event = Event::CreateEvent(*m_eventFactory, evString);
+	ASSERT_NE((Event*)NULL, m_event);
+	EXPECT_EQ(ZfsEvent::VDEV_STATECHANGE,
+		  static_cast<ZfsEvent*>(m_event)->GetKind());
+}
+
+/*
+ * ATTACH events name the device and its parent outside of name=value pairs
+ */
+TEST(EventTest, ParseAttach)
+{
+	EventFactory factory(Event::Builder);
+	string evString("+da3 at scbus0 target=3 lun=0 on ahcich3\n");
+	Event *event(Event::CreateEvent(factory, evString));
+
+	ASSERT_NE((Event*)NULL, event);
+	EXPECT_EQ(Event::ATTACH, event->GetType());
+	EXPECT_EQ(string("da3"), event->Value("device-name"));
+	EXPECT_EQ(string("ahcich3"), event->Value("parent"));
+	EXPECT_EQ(string("3"), event->Value("target"));
+	EXPECT_EQ(string("0"), event->Value("lun"));
+	EXPECT_EQ(string("none"), event->Value(KEY_SYSTEM));
+	delete event;
+
+	/* A name=value pair must not directly follow the event type. */
+	evString = "+foo=bar on ahcich3\n";
+	EXPECT_EQ((Event*)NULL, Event::CreateEvent(factory, evString));
+}
+
+/*
+ * NOMATCH and unrecognized events are rejected by status, not exception
+ */
+TEST(EventTest, DiscardedTypes)
+{
+	EventFactory factory(Event::Builder);
+	string evString("? at bus=0 slot=31 function=3 on pci0\n");
+
+	EXPECT_EQ(Event::PARSE_OK, Event::CheckType(Event::NOTIFY));
+	EXPECT_EQ(Event::PARSE_OK, Event::CheckType(Event::ATTACH));
+	EXPECT_EQ(Event::PARSE_OK, Event::CheckType(Event::DETACH));
+	EXPECT_EQ(Event::PARSE_DISCARDED, Event::CheckType(Event::NOMATCH));
+	EXPECT_EQ(Event::PARSE_UNKNOWN_TYPE,
+		  Event::CheckType(static_cast<Event::Type>('#')));
+
+	EXPECT_EQ((Event*)NULL, Event::CreateEvent(factory, evString));
+	evString = "#system=ZFS\n";
+	EXPECT_EQ((Event*)NULL, Event::CreateEvent(factory, evString));
+}
+
+/*
+ * The ingress filter identifies an event's system without parsing it,
+ * and accepts only events for which a build method is registered.
+ */
+TEST(EventTest, IngressFilter)
+{
+	EventFactory::Record records[] = {
+		{ Event::NOTIFY, "ZFS", &Event::Builder }
+	};
+	EventFactory factory;
+
+	factory.UpdateRegistry(records, NUM_ELEMENTS(records));
+
+	EXPECT_EQ(string("ZFS"),
+		  Event::PeekSystem("!system=ZFS subsystem=ZFS type=x\n"));
+	EXPECT_EQ(string("ACPI"),
+		  Event::PeekSystem("!subsystem=CMBAT system=ACPI\n"));
+	EXPECT_EQ(string("none"),
+		  Event::PeekSystem("+da0 at scbus0 on ahcich0\n"));
+	EXPECT_EQ(string("none"), Event::PeekSystem("!subsystem=ZFS\n"));
+
+	EXPECT_TRUE(factory.Accepts(Event::NOTIFY, "ZFS"));
+	EXPECT_FALSE(factory.Accepts(Event::NOTIFY, "ZFSX"));
+	EXPECT_FALSE(factory.Accepts(Event::NOTIFY, "ACPI"));
+	EXPECT_FALSE(factory.Accepts(Event::ATTACH, "ZFS"));
+	EXPECT_FALSE(factory.Accepts(Event::NOMATCH, "none"));
+
+	EventFactory defaultFactory(Event::Builder);
+	EXPECT_TRUE(defaultFactory.Accepts(Event::NOTIFY, "ACPI"));
+}
+
+TEST(EventTest, FactoryDispatch)
+{
+	EventFactory::Record records[] = {
+		{ Event::NOTIFY, "ZFS",   &Event::Builder },
+		{ Event::NOTIFY, "DEVFS", &DevCtl::DevfsEvent::Builder },
+		{ Event::NOTIFY, "GEOM",  &DevCtl::ZfsEvent::Builder },
+		{ Event::ATTACH, "ZFS",   &Event::Builder }
+	};
+	EventFactory::Record removals[] = {
+		{ Event::NOTIFY, "GEOM",  NULL }
+	};
+	EventFactory factory;
+
+	EXPECT_EQ((Event::BuildMethod *)NULL,
+		  factory.Lookup(Event::NOTIFY, "ZFS"));
+
+	factory.UpdateRegistry(records, NUM_ELEMENTS(records));
+	EXPECT_EQ(&Event::Builder, factory.Lookup(Event::NOTIFY, "ZFS"));
+	EXPECT_EQ(&DevCtl::DevfsEvent::Builder,
+		  factory.Lookup(Event::NOTIFY, "DEVFS"));
+	EXPECT_EQ(&DevCtl::ZfsEvent::Builder,
+		  factory.Lookup(Event::NOTIFY, "GEOM"));
+	EXPECT_EQ(&Event::Builder, factory.Lookup(Event::ATTACH, "ZFS"));
+	EXPECT_EQ((Event::BuildMethod *)NULL,
+		  factory.Lookup(Event::DETACH, "ZFS"));
+	EXPECT_EQ((Event::BuildMethod *)NULL,
+		  factory.Lookup(Event::NOTIFY, "ZF"));
+
+	factory.UpdateRegistry(removals, NUM_ELEMENTS(removals));
+	EXPECT_EQ((Event::BuildMethod *)NULL,
+		  factory.Lookup(Event::NOTIFY, "GEOM"));
+	EXPECT_EQ(&DevCtl::DevfsEvent::Builder,
+		  factory.Lookup(Event::NOTIFY, "DEVFS"));
+
+	/* Copies must dispatch through their own registry strings. */
+	EventFactory copy(factory);
+	factory = EventFactory();
+	EXPECT_EQ((Event::BuildMethod *)NULL,
+		  factory.Lookup(Event::NOTIFY, "ZFS"));
+	EXPECT_EQ((Event::BuildMethod *)NULL,
+		  copy.Lookup(Event::NOTIFY, "GEOM"));
+	EXPECT_EQ(&Event::Builder, copy.Lookup(Event::NOTIFY, "ZFS"));
+}
+
+TEST(EventTest, Subscriptions)
+{
+	EventFactory::Record records[] = {
+		{ Event::NOTIFY, "ZFS",   &Event::Builder }
+	};
+	EventFactory::Subscription subscriptions[] = {
+		{ Event::NOTIFY, "ZFS", "class=ereport.fs.zfs.*",
+		  &DevCtl::ZfsEvent::Builder },
+		{ Event::NOTIFY, "ZFS", "class=ereport.fs.zfs.checksum", NULL },
+		{ Event::NOTIFY, "ZFS", "class=ereport.*", NULL },
+		{ Event::NOTIFY, "DEVFS", "type=CREATE subsystem=CDEV",
+		  &DevCtl::DevfsEvent::Builder },
+		{ Event::NOTIFY, "ACPI", "type=x", NULL }
+	};
+	EventFactory factory;
+	Event	    *event;
+	StringView   value;
+
+	factory.UpdateRegistry(records, NUM_ELEMENTS(records));
+	factory.Subscribe(subscriptions, NUM_ELEMENTS(subscriptions));
+
+	EXPECT_TRUE(Event::PeekField("!system=ZFS class=a.b", "class", value));
+	EXPECT_EQ(string("a.b"), value);
+	EXPECT_FALSE(Event::PeekField("!system=ZFS subclass=a", "class",
+				      value));
+
+	/* The longest matching prefix wins. */
+	event = Event::CreateEventView(factory,
+	    "!system=ZFS subsystem=ZFS type=x class=ereport.fs.zfs.io\n",
+	    /*lazy*/true);
+	EXPECT_TRUE(dynamic_cast<DevCtl::ZfsEvent *>(event) != NULL);
+	delete event;
+
+	/* An exact value takes precedence over any prefix. */
+	EXPECT_EQ((Event *)NULL, Event::CreateEventView(factory,
+	    "!system=ZFS subsystem=ZFS type=x class=ereport.fs.zfs.checksum\n",
+	    /*lazy*/true));
+	EXPECT_EQ((Event *)NULL, Event::CreateEventView(factory,
+	    "!system=ZFS subsystem=ZFS type=x class=ereport.fs.other\n"));
+
+	/* Events matching no subscription fall back to the registry. */
+	event = Event::CreateEventView(factory,
+	    "!system=ZFS subsystem=ZFS type=misc.fs.zfs.config_sync\n");
+	ASSERT_TRUE(event != NULL);
+	EXPECT_TRUE(dynamic_cast<DevCtl::ZfsEvent *>(event) == NULL);
+	delete event;
+
+	/* All conditions must hold. */
+	event = Event::CreateEventView(factory,
+	    "!system=DEVFS subsystem=CDEV type=CREATE cdev=da0\n");
+	EXPECT_TRUE(dynamic_cast<DevCtl::DevfsEvent *>(event) != NULL);
+	delete event;
+	EXPECT_EQ((Event *)NULL, Event::CreateEventView(factory,
+	    "!system=DEVFS subsystem=CDEV type=DESTROY cdev=da0\n"));
+	EXPECT_EQ((Event *)NULL, Event::CreateEventView(factory,
+	    "!system=DEVFS subsystem=DEVFS type=CREATE\n"));
+
+	/*
+	 * The last occurrence of a duplicated field is matched, whether
+	 * or not its parsing was deferred.
+	 */
+	EXPECT_TRUE(Event::PeekField("!class=a class=b", "class", value));
+	EXPECT_EQ(string("b"), value);
+	for (int lazy(0); lazy < 2; lazy++) {
+		event = Event::CreateEventView(factory,
+		    "!system=ZFS subsystem=ZFS type=x "
+		    "class=ereport.fs.zfs.checksum class=ereport.fs.zfs.io\n",
+		    /*lazy*/lazy != 0);
+		EXPECT_TRUE(dynamic_cast<DevCtl::ZfsEvent *>(event) != NULL);
+		delete event;
+
+		event = Event::CreateEventView(factory,
+		    "!system=DEVFS subsystem=CDEV type=DESTROY cdev=da0 "
+		    "type=CREATE\n", /*lazy*/lazy != 0);
+		EXPECT_TRUE(dynamic_cast<DevCtl::DevfsEvent *>(event) != NULL);
+		delete event;
+	}
+
+	EXPECT_TRUE(factory.Accepts(Event::NOTIFY, "ZFS"));
+	EXPECT_TRUE(factory.Accepts(Event::NOTIFY, "DEVFS"));
+	EXPECT_FALSE(factory.Accepts(Event::NOTIFY, "ACPI"));
+	EXPECT_EQ((Event::BuildMethod *)NULL,
+		  factory.Lookup(Event::NOTIFY, "DEVFS"));
+}
+
+/*
+ * Test class EventBuffer
+ */
+class EventBufferTest : public ::testing::Test
+{
+protected:
+	virtual void SetUp()
+	{
+		ASSERT_EQ(0, pipe(m_pipeFD));
+	}
+
+	virtual void TearDown()
+	{
+		close(m_pipeFD[0]);
+		close(m_pipeFD[1]);
+	}
+
+	void Write(const string &data)
+	{
+		ASSERT_EQ((ssize_t)data.length(),
+			  write(m_pipeFD[1], data.data(), data.length()));
+	}
+
+	/** \return  An event exactly len bytes long, including its end. */
+	static string MakeEvent(size_t len)
+	{
+		string event("!system=ZFS subsystem=ZFS type=x pad=");
+
+		event.append(len - event.length() - 1, 'p');
+		event += '\n';
+		return (event);
+	}
+
+	int m_pipeFD[2];
+};
+
+TEST_F(EventBufferTest, LoneTerminator)
+{
+	FDReader    reader(m_pipeFD[0]);
+	EventBuffer buffer(reader);
+	string	    event;
+
+	/* A terminator too short to be an event must not be skipped. */
+	Write("\n");
+	EXPECT_FALSE(buffer.ExtractEvent(event));
+
+	Write("!system=ZFS type=x\n");
+	ASSERT_TRUE(buffer.ExtractEvent(event));
+	EXPECT_EQ("\n", event);
+	ASSERT_TRUE(buffer.ExtractEvent(event));
+	EXPECT_EQ("!system=ZFS type=x\n", event);
+	EXPECT_FALSE(buffer.ExtractEvent(event));
+}
+
+/*
+ * Events are extracted intact as the ring wraps, including events that
+ * straddle its end and arrive in two pieces
+ */
+TEST_F(EventBufferTest, RingWrap)
+{
+	FDReader    reader(m_pipeFD[0]);
+	EventBuffer buffer(reader);
+	string	    event;
+
+	/* Several times the size of the ring, in events of varied size. */
+	for (size_t i(0); i < 500; i++) {
+		string expected(MakeEvent(100 + i % 97));
+		size_t split(expected.length() / 2);
+
+		Write(expected.substr(0, split));
+		EXPECT_FALSE(buffer.ExtractEvent(event));
+		Write(expected.substr(split));
+		ASSERT_TRUE(buffer.ExtractEvent(event));
+		ASSERT_EQ(expected, event);
+	}
+	EXPECT_FALSE(buffer.ExtractEvent(event));
+}
+
+/*
+ * Data received a byte at a time is scanned as it arrives, and each
+ * event is extracted as soon as its terminator is received
+ */
+TEST_F(EventBufferTest, Fragments)
+{
+	FDReader    reader(m_pipeFD[0]);
+	EventBuffer buffer(reader);
+	string	    data(MakeEvent(64) + MakeEvent(80) + "!\n");
+	string	    event;
+	size_t	    eventStart(0);
+
+	for (size_t i(0); i < data.length(); i++) {
+		Write(data.substr(i, 1));
+		if (data[i] != '\n') {
+			EXPECT_FALSE(buffer.ExtractEvent(event));
+			continue;
+		}
+		ASSERT_TRUE(buffer.ExtractEvent(event));
+		EXPECT_EQ(data.substr(eventStart, i + 1 - eventStart), event);
+		eventStart = i + 1;
+	}
+	EXPECT_FALSE(buffer.ExtractEvent(event));
+}
+
+/*
+ * The buffer grows to fit large events up to the configured limit,
+ * keeping the data already buffered.  The large event starts near the
+ * end of the ring, so its data has wrapped when the buffer grows.
+ */
+TEST_F(EventBufferTest, Grow)
+{
+	stringstream  stream;
+	string	      small(MakeEvent(100));
+	string	      large(MakeEvent(20000));
+	string	      event;
+
+	for (int i(0); i < 150; i++)
+		stream << small;
+	stream << large << small;
+
+	IstreamReader reader(&stream);
+	EventBuffer   buffer(reader, /*maxEventSize*/32 * 1024);
+
+	for (int i(0); i < 150; i++) {
+		ASSERT_TRUE(buffer.ExtractEvent(event));
+		ASSERT_EQ(small, event);
+	}
+	ASSERT_TRUE(buffer.ExtractEvent(event));
+	EXPECT_EQ(large, event);
+	ASSERT_TRUE(buffer.ExtractEvent(event));
+	EXPECT_EQ(small, event);
+	EXPECT_FALSE(buffer.ExtractEvent(event));
+
+	/* 8KB to 16KB, and then to 32KB. */
+	EXPECT_EQ((uint64_t)2, buffer.GetGrowCount());
+	EXPECT_EQ((uint64_t)0, buffer.GetTruncateCount());
+}
+
+/*
+ * Events larger than the limit are truncated at a field boundary, and
+ * the remainder of the event is discarded
+ */
+TEST_F(EventBufferTest, Truncate)
+{
+	stringstream  stream;
+	string	      small(MakeEvent(100));
+	string	      large(MakeEvent(10000));
+	string	      event;
+
+	stream << large << small;
+
+	IstreamReader reader(&stream);
+	EventBuffer   buffer(reader);
+
+	ASSERT_TRUE(buffer.ExtractEvent(event));
+	EXPECT_EQ("!system=ZFS subsystem=ZFS type=x\n", event);
+	ASSERT_TRUE(buffer.ExtractEvent(event));
+	EXPECT_EQ(small, event);
+	EXPECT_FALSE(buffer.ExtractEvent(event));
+
+	EXPECT_EQ((uint64_t)0, buffer.GetGrowCount());
+	EXPECT_EQ((uint64_t)1, buffer.GetTruncateCount());
+}
+
+/*
+ * Events read through an MmapReader are handed out in place, and a
+ * trailing partial event is left unconsumed
+ */
+TEST_F(EventBufferTest, MmapDirect)
+{
+	char	   path[] = "/tmp/zfsd_unittest.XXXXXX";
+	int	   fd(mkstemp(path));
+	string	   first(MakeEvent(100));
+	string	   second(MakeEvent(200));
+	string	   data(first + second + "!system=ZFS");
+	StringView view;
+
+	ASSERT_NE(-1, fd);
+	unlink(path);
+	ASSERT_EQ((ssize_t)data.length(),
+		  write(fd, data.data(), data.length()));
+
+	MmapReader  reader(fd);
+	EventBuffer buffer(reader);
+	size_t	    avail;
+	const char *mapped(reader.peek(avail));
+
+	ASSERT_EQ(data.length(), avail);
+	ASSERT_TRUE(buffer.ExtractEvent(view));
+	EXPECT_EQ(mapped, view.data());
+	EXPECT_EQ(first, view.str());
+	ASSERT_TRUE(buffer.ExtractEvent(view));
+	EXPECT_EQ(mapped + first.length(), view.data());
+	EXPECT_EQ(second, view.str());
+	EXPECT_FALSE(buffer.ExtractEvent(view));
+	EXPECT_EQ(mapped + first.length() + second.length(),
+		  reader.peek(avail));
+	EXPECT_EQ(strlen("!system=ZFS"), avail);
+	close(fd);
+
+	/* Only regular files can be mapped. */
+	EXPECT_THROW(MmapReader pipeReader(m_pipeFD[0]), DevCtl::Exception);
+}
+
+/*
+ * A non-blocking FDReader is read until it would block, rather than
+ * by the amount FIONREAD reports, and never blocks the caller
+ */
+TEST_F(EventBufferTest, NonBlocking)
+{
+	FDReader	    reader(m_pipeFD[0], /*nonBlocking*/true);
+	EventBuffer	    buffer(reader);
+	std::vector<string> events;
+	string		    expected(MakeEvent(120));
+	string		    event;
+
+	EXPECT_TRUE(reader.nonblocking());
+	EXPECT_NE(0, fcntl(m_pipeFD[0], F_GETFL) & O_NONBLOCK);
+
+	/* An empty pipe fails with EAGAIN. */
+	EXPECT_FALSE(buffer.ExtractEvent(event));
+	EXPECT_EQ((size_t)0, buffer.ExtractEvents(events));
+
+	for (int i(0); i < 100; i++)
+		Write(expected);
+	Write(expected.substr(0, 10));
+	for (int i(0); i < 100; i++) {
+		ASSERT_TRUE(buffer.ExtractEvent(event));
+		ASSERT_EQ(expected, event);
+	}
+	EXPECT_FALSE(buffer.ExtractEvent(event));
+
+	Write(expected.substr(10));
+	Write(expected);
+	EXPECT_EQ((size_t)2, buffer.ExtractEvents(events));
+	ASSERT_EQ((size_t)2, events.size());
+	EXPECT_EQ(expected, events[0]);
+	EXPECT_EQ(expected, events[1]);
+}
+
+/*
+ * Test class Consumer
+ */
+class TestConsumer : public DevCtl::Consumer
+{
+public:
+	/** Take over an already connected socket. */
+	TestConsumer(int sockFD)
+	 : Consumer(Event::Builder)
+	{
+		m_devdSockFD = sockFD;
+	}
+};
+
+class ConsumerTest : public ::testing::Test
+{
+protected:
+	virtual void SetUp()
+	{
+		ASSERT_EQ(0, socketpair(AF_UNIX, SOCK_SEQPACKET, 0, m_sockFD));
+		/* As set by Consumer::ConnectToDevd(). */
+		ASSERT_EQ(0, fcntl(m_sockFD[0], F_SETFL, O_NONBLOCK));
+		m_consumer = new TestConsumer(m_sockFD[0]);
+	}
+
+	virtual void TearDown()
+	{
+		/* The consumer closes its end of the socket. */
+		delete m_consumer;
+		close(m_sockFD[1]);
+	}
+
+	void Send(const string &record)
+	{
+		ASSERT_EQ((ssize_t)record.length(),
+			  send(m_sockFD[1], record.data(), record.length(), 0));
+	}
+
+	TestConsumer *m_consumer;
+	int	      m_sockFD[2];
+};
+
+TEST_F(ConsumerTest, FlushEvents)
+{
+	string record("!system=ZFS subsystem=ZFS "
+		      "type=misc.fs.zfs.config_sync\n");
+	size_t bytes(0);
+
+	for (int i(0); i < 3; i++)
+		Send(record);
+	EXPECT_EQ((size_t)3, m_consumer->FlushEvents(&bytes));
+	EXPECT_EQ(3 * record.length(), bytes);
+	EXPECT_FALSE(m_consumer->EventsPending());
+	EXPECT_EQ((size_t)0, m_consumer->FlushEvents(&bytes));
+	EXPECT_EQ((size_t)0, bytes);
+}
+
+/*
+ * NextEvents() receives every pending record, across several batched
+ * receives, and builds events from all but the discarded ones
+ */
+TEST_F(ConsumerTest, NextEvents)
+{
+	EventList events;
+	size_t	  numRecords(40);
+
+	Send("? at bus=0 slot=31 function=3 on pci0\n");
+	for (size_t i(1); i < numRecords; i++) {
+		stringstream record;
+
+		record << "!system=ZFS subsystem=ZFS type=x seq=" << i << "\n";
+		Send(record.str());
+	}
+
+	EXPECT_EQ(numRecords, m_consumer->NextEvents(events));
+	ASSERT_EQ(numRecords - 1, events.size());
+
+	size_t seq(1);
+	for (EventList::iterator event(events.begin()); event != events.end();
+	     event++, seq++) {
+		stringstream expected;
+
+		expected << seq;
+		EXPECT_EQ(expected.str(), (*event)->Value("seq"));
+	}
+	events.clear();
+
+	EXPECT_EQ((size_t)0, m_consumer->NextEvents(events));
+	EXPECT_TRUE(events.empty());
+}
+
 /*
  * Test class CaseFile
  */
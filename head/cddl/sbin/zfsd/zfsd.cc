@@ -53,12 +53,17 @@
 
 #include <libzfs.h>
 
+#include <cstring>
 #include <list>
 #include <map>
 #include <string>
+#include <vector>
 
 #include <devctl/guid.h>
+#include <devctl/string_view.h>
 #include <devctl/event.h>
+#include <devctl/event_arena.h>
+#include <devctl/event_clock.h>
 #include <devctl/event_factory.h>
 #include <devctl/exception.h>
 #include <devctl/consumer.h>
@@ -80,6 +85,7 @@ __FBSDID("$FreeBSD$");
 
 /*============================ Namespace Control =============================*/
 using DevCtl::Event;
+using DevCtl::EventArena;
 using DevCtl::EventFactory;
 using DevCtl::EventList;
 
@@ -98,10 +104,19 @@ int		     ZfsDaemon::s_signalPipeFD[2];
 bool		     ZfsDaemon::s_systemRescanRequested(false);
 EventFactory::Record ZfsDaemon::s_registryEntries[] =
 {
-	{ Event::NOTIFY, "DEVFS", &DevfsEvent::Builder },
 	{ Event::NOTIFY, "ZFS",   &ZfsEvent::Builder }
 };
 
+/*
+ * Of DEVFS events, only device arrivals can introduce new vdevs.
+ * All others are rejected without being built.
+ */
+const EventFactory::Subscription ZfsDaemon::s_subscriptions[] =
+{
+	{ Event::NOTIFY, "DEVFS", "subsystem=CDEV type=CREATE",
+	  &DevfsEvent::Builder }
+};
+
 //- ZfsDaemon Static Public Methods --------------------------------------------
 ZfsDaemon &
 ZfsDaemon::Get()
@@ -152,7 +167,9 @@ ZfsDaemon::Run()
 //- ZfsDaemon Private Methods --------------------------------------------------
 ZfsDaemon::ZfsDaemon()
  : Consumer(/*defBuilder*/NULL, s_registryEntries,
-	    NUM_ELEMENTS(s_registryEntries))
+	    NUM_ELEMENTS(s_registryEntries), DevCtl::EventClock::COARSE,
+	    /*lazyParsing*/true, s_subscriptions,
+	    NUM_ELEMENTS(s_subscriptions))
 {
 	if (s_theZfsDaemon != NULL)
 		errx(1, "Multiple ZfsDaemon instances created. Exiting");
@@ -248,7 +265,7 @@ ZfsDaemon::BuildCaseFiles()
 		snprintf(evString, 160, "!system=ZFS subsystem=ZFS "
 		    "type=misc.fs.zfs.config_sync sub_type=synthesized "
 		    "pool_name=%s pool_guid=%lu\n", poolname, poolGUID);
-		event = Event::CreateEvent(GetFactory(), string(evString));
+		event = Event::CreateEventView(GetFactory(), evString);
 		if (event != NULL) {
 			event->Process();
 			delete event;
@@ -286,8 +303,8 @@ ZfsDaemon::RescanSystem()
 				Event *event;
 
 				string evString(evStart + pp->lg_name + "\n");
-				event = Event::CreateEvent(GetFactory(),
-							   evString);
+				event = Event::CreateEventView(GetFactory(),
+							       evString);
 				if (event != NULL) {
 					if (event->Process())
 						SaveEvent(*event);
@@ -303,6 +320,9 @@ void
 ZfsDaemon::DetectMissedEvents()
 {
 	do {
+		size_t numEvents;
+		size_t numBytes;
+
 		PurgeCaseFiles();
 
 		/*
@@ -310,7 +330,10 @@ ZfsDaemon::DetectMissedEvents()
 		 * if they still apply to the current state of the
 		 * system.
 		 */
-		FlushEvents();
+		numEvents = FlushEvents(&numBytes);
+		if (numEvents != 0)
+			syslog(LOG_INFO, "Discarded %zu stale events "
+			       "(%zu bytes)", numEvents, numBytes);
 
 		BuildCaseFiles();
 
@@ -334,6 +357,22 @@ ZfsDaemon::EventLoop()
 			EventList::iterator event(m_unconsumedEvents.begin());
 			s_logCaseFiles = false;
 			CaseFile::LogAll();
+			syslog(LOG_INFO,
+			       "%ju events discarded without a full parse",
+			       (uintmax_t)Event::UnparsedEventCount());
+			syslog(LOG_INFO,
+			       "Event arena: %ju allocations, %ju chunks; "
+			       "%ju event heap allocations",
+			       (uintmax_t)GetEventArena().Allocations(),
+			       (uintmax_t)GetEventArena().ChunkAllocations(),
+			       (uintmax_t)EventArena::HeapAllocations());
+			for (DropCountList::const_iterator drop =
+			     GetDropCounts().begin();
+			     drop != GetDropCounts().end(); drop++)
+				syslog(LOG_INFO,
+				       "%ju %s events dropped unparsed",
+				       (uintmax_t)drop->m_count,
+				       drop->m_system.c_str());
 			while (event != m_unconsumedEvents.end())
 				(*event++)->Log(LOG_INFO);
 		}
@@ -44,12 +44,17 @@
  *
  *    #include <libzfs.h>
  *
+ *    #include <cstring>
  *    #include <list>
  *    #include <map>
  *    #include <string>
+ *    #include <vector>
  *
  *    #include <devctl/guid.h>
+ *    #include <devctl/string_view.h>
  *    #include <devctl/event.h>
+ *    #include <devctl/event_arena.h>
+ *    #include <devctl/event_clock.h>
  *    #include <devctl/event_factory.h>
  *    #include <devctl/consumer.h>
  *
@@ -223,6 +228,8 @@ private:
 	static bool				s_consumingEvents;
 
 	static DevCtl::EventFactory::Record	s_registryEntries[];
+
+	static const DevCtl::EventFactory::Subscription s_subscriptions[];
 };
 
 #endif	/* _ZFSD_H_ */
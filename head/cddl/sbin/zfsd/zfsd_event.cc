@@ -41,13 +41,18 @@
 
 #include <libzfs.h>
 
+#include <cstring>
 #include <list>
 #include <map>
 #include <sstream>
 #include <string>
+#include <vector>
 
 #include <devctl/guid.h>
+#include <devctl/string_view.h>
 #include <devctl/event.h>
+#include <devctl/event_arena.h>
+#include <devctl/event_clock.h>
 #include <devctl/event_factory.h>
 #include <devctl/exception.h>
 #include <devctl/consumer.h>
@@ -65,7 +70,12 @@ __FBSDID("$FreeBSD$");
 /*============================ Namespace Control =============================*/
 using DevCtl::Event;
 using DevCtl::Guid;
+using DevCtl::KEY_CLASS;
+using DevCtl::KEY_POOL_GUID;
+using DevCtl::KEY_TYPE;
+using DevCtl::KEY_VDEV_GUID;
 using DevCtl::NVPairMap;
+using DevCtl::StringView;
 using std::stringstream;
 
 /*=========================== Class Implementations ==========================*/
@@ -76,9 +86,10 @@ using std::stringstream;
 Event *
 DevfsEvent::Builder(Event::Type type,
 		    NVPairMap &nvPairs,
-		    const string &eventString)
+		    const StringView &eventString)
 {
-	return (new DevfsEvent(type, nvPairs, eventString));
+	return (new (nvPairs.GetArena())
+	    DevfsEvent(type, nvPairs, eventString));
 }
 
 //- DevfsEvent Static Protected Methods ----------------------------------------
@@ -162,7 +173,7 @@ DevfsEvent::Process() const
 	 * We are only concerned with newly discovered
 	 * devices that can be ZFS vdevs.
 	 */
-	if (Value("type") != "CREATE" || !IsDiskDev())
+	if (Value(KEY_TYPE) != "CREATE" || !IsDiskDev())
 		return (false);
 
 	/* Log the event since it is of interest. */
@@ -216,7 +227,7 @@ DevfsEvent::Process() const
 
 //- DevfsEvent Protected Methods -----------------------------------------------
 DevfsEvent::DevfsEvent(Event::Type type, NVPairMap &nvpairs,
-			       const string &eventString)
+			       const StringView &eventString)
  : DevCtl::DevfsEvent(type, nvpairs, eventString)
 {
 }
@@ -230,9 +241,9 @@ DevfsEvent::DevfsEvent(const DevfsEvent &src)
 //- ZfsEvent Static Public Methods ---------------------------------------------
 DevCtl::Event *
 ZfsEvent::Builder(Event::Type type, NVPairMap &nvpairs,
-		  const string &eventString)
+		  const StringView &eventString)
 {
-	return (new ZfsEvent(type, nvpairs, eventString));
+	return (new (nvpairs.GetArena()) ZfsEvent(type, nvpairs, eventString));
 }
 
 //- ZfsEvent Virtual Public Methods --------------------------------------------
@@ -247,14 +258,14 @@ ZfsEvent::Process() const
 {
 	string logstr("");
 
-	if (!Contains("class") && !Contains("type")) {
+	if (!Contains(KEY_CLASS) && !Contains(KEY_TYPE)) {
 		syslog(LOG_ERR,
 		       "ZfsEvent::Process: Missing class or type data.");
 		return (false);
 	}
 
 	/* On config syncs, replay any queued events first. */
-	if (Value("type").find("misc.fs.zfs.config_sync") == 0) {
+	if (GetKind() == CONFIG_SYNC) {
 		/*
 		 * Even if saved events are unconsumed the second time
 		 * around, drop them.  Any events that still can't be
@@ -265,13 +276,13 @@ ZfsEvent::Process() const
 		CaseFile::ReEvaluateByGuid(PoolGUID(), *this);
 	}
 
-	if (Value("type").find("misc.fs.zfs.") == 0) {
+	if (IsPoolEvent()) {
 		/* Configuration changes, resilver events, etc. */
 		ProcessPoolEvent();
 		return (false);
 	}
 
-	if (!Contains("pool_guid") || !Contains("vdev_guid")) {
+	if (!Contains(KEY_POOL_GUID) || !Contains(KEY_VDEV_GUID)) {
 		/* Only currently interested in Vdev related events. */
 		return (false);
 	}
@@ -287,7 +298,7 @@ ZfsEvent::Process() const
 	/* Skip events that can't be handled. */
 	Guid poolGUID(PoolGUID());
 	/* If there are no replicas for a pool, then it's not manageable. */
-	if (Value("class").find("fs.zfs.vdev.no_replicas") == 0) {
+	if (GetKind() == NO_REPLICAS_EREPORT) {
 		stringstream msg;
 		msg << "No replicas available for pool "  << poolGUID;
 		msg << ", ignoring";
@@ -342,7 +353,7 @@ ZfsEvent::Process() const
 
 //- ZfsEvent Protected Methods -------------------------------------------------
 ZfsEvent::ZfsEvent(Event::Type type, NVPairMap &nvpairs,
-			   const string &eventString)
+			   const StringView &eventString)
  : DevCtl::ZfsEvent(type, nvpairs, eventString)
 {
 }
@@ -378,7 +389,7 @@ ZfsEvent::ProcessPoolEvent() const
 	bool degradedDevice(false);
 
 	/* The pool is destroyed.  Discard any open cases */
-	if (Value("type") == "misc.fs.zfs.pool_destroy") {
+	if (GetKind() == POOL_DESTROY) {
 		Log(LOG_INFO);
 		CaseFile::ReEvaluateByGuid(PoolGUID(), *this);
 		return;
@@ -393,7 +404,7 @@ ZfsEvent::ProcessPoolEvent() const
 		Log(LOG_INFO);
 		caseFile->ReEvaluate(*this);
 	}
-	else if (Value("type") == "misc.fs.zfs.resilver_finish")
+	else if (GetKind() == RESILVER_FINISH)
 	{
 		/*
 		 * It's possible to get a resilver_finish event with no
@@ -404,7 +415,7 @@ ZfsEvent::ProcessPoolEvent() const
 		CleanupSpares();
 	}
 
-	if (Value("type") == "misc.fs.zfs.vdev_remove"
+	if (GetKind() == VDEV_REMOVE
 	 && degradedDevice == false) {
 
 		/* See if any other cases can make use of this device. */
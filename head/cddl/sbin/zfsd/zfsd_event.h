@@ -39,11 +39,13 @@
  *        the devctl API.
  *
  * Header requirements:
+ *    #include <cstring>
  *    #include <string>
  *    #include <list>
  *    #include <map>
  *
  *    #include <devctl/guid.h>
+ *    #include <devctl/string_view.h>
  *    #include <devctl/event.h>
  */
 
@@ -114,7 +116,7 @@ protected:
 	DevfsEvent(const DevfsEvent &src);
 
 	/** Constructor */
-	DevfsEvent(Type, DevCtl::NVPairMap &, const string &);
+	DevfsEvent(Type, DevCtl::NVPairMap &, const DevCtl::StringView &);
 };
 
 /*--------------------------------- ZfsEvent ---------------------------------*/
@@ -138,7 +140,7 @@ protected:
 	ZfsEvent(const ZfsEvent &src);
 
 	/** Constructor */
-	ZfsEvent(Type, DevCtl::NVPairMap &, const string &);
+	ZfsEvent(Type, DevCtl::NVPairMap &, const DevCtl::StringView &);
 
 	/**
 	 * Detach any spares that are no longer needed, but were not
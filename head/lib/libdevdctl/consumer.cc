@@ -35,8 +35,11 @@
  */
 
 #include <sys/cdefs.h>
+#include <sys/ioctl.h>
 #include <sys/poll.h>
 #include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/uio.h>
 #include <sys/un.h>
 
 #include <err.h>
@@ -45,14 +48,19 @@
 #include <syslog.h>
 #include <unistd.h>
 
+#include <algorithm>
 #include <cstdarg>
 #include <cstring>
 #include <list>
 #include <map>
 #include <string>
+#include <vector>
 
 #include "guid.h"
+#include "string_view.h"
 #include "event.h"
+#include "event_arena.h"
+#include "event_clock.h"
 #include "event_factory.h"
 #include "exception.h"
 
@@ -76,12 +84,19 @@ const char Consumer::s_devdSockPath[] = "/var/run/devd.seqpacket.pipe";
 //- Consumer Public Methods ----------------------------------------------------
 Consumer::Consumer(Event::BuildMethod *defBuilder,
 		   EventFactory::Record *regEntries,
-		   size_t numEntries)
+		   size_t numEntries,
+		   EventClock::Source clockSource,
+		   bool lazyParsing,
+		   const EventFactory::Subscription *subscriptions,
+		   size_t numSubscriptions)
  : m_devdSockFD(-1),
    m_eventFactory(defBuilder),
+   m_clock(clockSource),
+   m_lazyParsing(lazyParsing),
    m_replayingEvents(false)
 {
 	m_eventFactory.UpdateRegistry(regEntries, numEntries);
+	m_eventFactory.Subscribe(subscriptions, numSubscriptions);
 }
 
 Consumer::~Consumer()
@@ -136,20 +151,74 @@ Consumer::DisconnectFromDevd()
 	m_devdSockFD = -1;
 }
 
-std::string
-Consumer::ReadEvent()
+size_t
+Consumer::ReadEvent(size_t offset)
 {
-	char buf[MAX_EVENT_SIZE + 1];
 	ssize_t len;
 
-	len = ::recv(m_devdSockFD, buf, MAX_EVENT_SIZE, MSG_WAITALL);
+	len = ::recv(m_devdSockFD, &m_recvBuf[offset], MAX_EVENT_SIZE,
+		     MSG_WAITALL);
 	if (len == -1)
-		return (std::string(""));
-	else {
-		/* NULL-terminate the result */
-		buf[len] = '\0';
-		return (std::string(buf));
+		return (0);
+	return (len);
+}
+
+size_t
+Consumer::ReadEvents(size_t offset, size_t maxRecords, size_t *lengths)
+{
+	maxRecords = std::min(maxRecords, (size_t)RECV_BATCH);
+	ReserveRecordSlot(offset, maxRecords);
+
+#ifdef MSG_WAITFORONE
+	/* recvmmsg(2) is available. */
+	struct mmsghdr msgs[RECV_BATCH];
+	struct iovec   iovs[RECV_BATCH];
+	int	       received;
+
+	memset(msgs, 0, maxRecords * sizeof(*msgs));
+	for (size_t i(0); i < maxRecords; i++) {
+		iovs[i].iov_base = &m_recvBuf[offset + i * RECORD_SLOT_SIZE];
+		iovs[i].iov_len  = MAX_EVENT_SIZE;
+		msgs[i].msg_hdr.msg_iov    = &iovs[i];
+		msgs[i].msg_hdr.msg_iovlen = 1;
 	}
+
+	received = recvmmsg(m_devdSockFD, msgs, maxRecords, MSG_DONTWAIT,
+			    NULL);
+	if (received == -1)
+		return (0);
+
+	for (int i(0); i < received; i++)
+		lengths[i] = msgs[i].msg_len;
+	return (received);
+#else
+	size_t numRecords(0);
+
+	/*
+	 * Don't block once the socket is drained, whether or not it
+	 * was opened non-blocking.
+	 */
+	for (; numRecords < maxRecords; numRecords++) {
+		size_t  slot(offset + numRecords * RECORD_SLOT_SIZE);
+		ssize_t len;
+
+		len = ::recv(m_devdSockFD, &m_recvBuf[slot], MAX_EVENT_SIZE,
+			     MSG_DONTWAIT);
+		if (len <= 0)
+			break;
+		lengths[numRecords] = len;
+	}
+	return (numRecords);
+#endif
+}
+
+void
+Consumer::ReserveRecordSlot(size_t offset, size_t numSlots)
+{
+	size_t needed(offset + numSlots * RECORD_SLOT_SIZE);
+
+	if (m_recvBuf.size() < needed)
+		m_recvBuf.resize(needed);
 }
 
 void
@@ -164,7 +233,6 @@ Consumer::ReplayUnconsumedEvents(bool discardUnconsumed)
 	while (event != m_unconsumedEvents.end()) {
 		bool consumed((*event)->Process());
 		if (consumed || discardUnconsumed) {
-			delete *event;
 			event = m_unconsumedEvents.erase(event);
 		} else {
 			event++;
@@ -180,7 +248,7 @@ Consumer::SaveEvent(const Event &event)
 {
         if (m_replayingEvents)
                 return (false);
-        m_unconsumedEvents.push_back(event.DeepCopy());
+        m_unconsumedEvents.push_back(event.Retain());
         return (true);
 }
 
@@ -192,12 +260,15 @@ Consumer::NextEvent()
 
 	Event *event(NULL);
 	try {
-		string evString;
-
-		evString = ReadEvent();
-		if (! evString.empty()) {
-			Event::TimestampEventString(evString);
-			event = Event::CreateEvent(m_eventFactory, evString);
+		size_t len;
+
+		ReserveRecordSlot(0);
+		len = ReadEvent(0);
+		if (len != 0 && FilterEvent(StringView(&m_recvBuf[0], len))) {
+			m_clock.Expire();
+			event = Event::CreateEventView(m_eventFactory,
+			    StringView(&m_recvBuf[0], len), m_lazyParsing,
+			    &m_eventArena, &m_clock);
 		}
 	} catch (const Exception &exp) {
 		exp.Log();
@@ -206,26 +277,171 @@ Consumer::NextEvent()
 	return (event);
 }
 
+size_t
+Consumer::NextEvents(EventList &events)
+{
+	size_t numRecords(0);
+
+	if (!Connected())
+		return (0);
+
+	try {
+		size_t  numEvents(0);
+		size_t  offsets[MAX_BATCH_EVENTS];
+		size_t  lengths[MAX_BATCH_EVENTS];
+		size_t  used(0);
+
+		/*
+		 * Receive the whole batch before creating any events.
+		 * m_recvBuf may be resized while records are received,
+		 * so views into it are only taken once it is stable.
+		 */
+		m_clock.Expire();
+		while (numRecords < MAX_BATCH_EVENTS) {
+			size_t wanted(std::min((size_t)RECV_BATCH,
+					       MAX_BATCH_EVENTS - numRecords));
+			size_t batchLengths[RECV_BATCH];
+			size_t received;
+			size_t slot(used);
+
+			received = ReadEvents(used, wanted, batchLengths);
+			for (size_t i(0); i < received;
+			     i++, slot += RECORD_SLOT_SIZE) {
+				size_t len(batchLengths[i]);
+
+				if (len == 0)
+					continue;
+
+				numRecords++;
+				if (!FilterEvent(StringView(&m_recvBuf[slot],
+							    len)))
+					continue;
+
+				/*
+				 * Pack the record against its predecessor,
+				 * so that a batch of small records occupies
+				 * little more than their combined size.
+				 * Dropped records are overwritten.
+				 */
+				if (slot != used)
+					memmove(&m_recvBuf[used],
+						&m_recvBuf[slot], len);
+				offsets[numEvents] = used;
+				lengths[numEvents] = len;
+				used += len;
+				numEvents++;
+			}
+
+			/* A short batch means the socket has been drained. */
+			if (received < wanted)
+				break;
+		}
+
+		for (size_t i(0); i < numEvents; i++) {
+			Event *event;
+
+			event = Event::CreateEventView(m_eventFactory,
+			    StringView(&m_recvBuf[offsets[i]], lengths[i]),
+			    m_lazyParsing, &m_eventArena, &m_clock);
+			if (event != NULL)
+				events.push_back(EventHandle(event));
+		}
+	} catch (const Exception &exp) {
+		exp.Log();
+		DisconnectFromDevd();
+	}
+	return (numRecords);
+}
+
+bool
+Consumer::FilterEvent(const StringView &eventString)
+{
+	Event::Type type(static_cast<Event::Type>(eventString[0]));
+	StringView  system(Event::PeekSystem(eventString));
+
+	if (m_eventFactory.Accepts(type, system))
+		return (true);
+
+	for (DropCountList::iterator drop(m_dropCounts.begin());
+	     drop != m_dropCounts.end(); drop++) {
+		if (system == StringView(drop->m_system)) {
+			drop->m_count++;
+			return (false);
+		}
+	}
+
+	DropCount drop;
+
+	drop.m_system = system.str();
+	drop.m_count  = 1;
+	m_dropCounts.push_back(drop);
+	return (false);
+}
+
 /* Capture and process buffered events. */
 void
 Consumer::ProcessEvents()
 {
-	Event *event;
-	while ((event = NextEvent()) != NULL) {
-		if (event->Process())
-			SaveEvent(*event);
-		delete event;
+	EventList events;
+
+	while (NextEvents(events) != 0) {
+		while (!events.empty()) {
+			EventHandle event(events.front());
+
+			events.pop_front();
+			if (event->Process())
+				SaveEvent(*event);
+		}
 	}
 }
 
-void
-Consumer::FlushEvents()
+size_t
+Consumer::FlushEvents(size_t *discardedBytes)
 {
-	std::string s;
+	size_t numEvents(0);
+	size_t numBytes(0);
+	bool   lengthsKnown(true);
+	int    queuedBytes(0);
+
+	/*
+	 * Each record is received into a one byte buffer, and the rest
+	 * of it is dropped by the socket without being copied.  Given
+	 * MSG_TRUNC, Linux reports the full length of a truncated
+	 * record.  Other systems, FreeBSD among them, report only the
+	 * byte copied, so the data queued when the flush began is
+	 * reported instead.
+	 */
+	if (discardedBytes != NULL
+	 && ioctl(m_devdSockFD, FIONREAD, &queuedBytes) == -1)
+		queuedBytes = 0;
+
+	for (;;) {
+		char	      discard;
+		struct iovec  iov;
+		struct msghdr msg;
+		ssize_t	      len;
+
+		iov.iov_base = &discard;
+		iov.iov_len  = sizeof(discard);
+		memset(&msg, 0, sizeof(msg));
+		msg.msg_iov    = &iov;
+		msg.msg_iovlen = 1;
+		len = ::recvmsg(m_devdSockFD, &msg, MSG_TRUNC | MSG_DONTWAIT);
+		if (len <= 0)
+			break;
+		if ((msg.msg_flags & MSG_TRUNC) != 0
+		 && (size_t)len <= sizeof(discard))
+			lengthsKnown = false;
+		numEvents++;
+		numBytes += len;
+	}
+
+	if (!lengthsKnown)
+		numBytes = std::max(numBytes, (size_t)queuedBytes);
 
-	do
-		s = ReadEvent();
-	while (! s.empty()) ;
+	if (discardedBytes != NULL)
+		*discardedBytes = numBytes;
+	return (numEvents);
 }
 
 bool
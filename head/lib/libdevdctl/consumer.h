@@ -55,9 +55,40 @@ class FDReader;
 class Consumer
 {
 public:
+	/**
+	 * The number of events from a single system that were dropped
+	 * because no build method accepts them.
+	 */
+	struct DropCount
+	{
+		std::string m_system;
+		uint64_t    m_count;
+	};
+
+	typedef std::vector<DropCount> DropCountList;
+
+	/**
+	 * Constructor
+	 *
+	 * \param defBuilder   Build method for events with no registry entry.
+	 * \param regEntries   Event factory registry entries.
+	 * \param numEntries   The number of entries in regEntries.
+	 * \param clockSource  The clocks used to record the receive time
+	 *                     of events.
+	 * \param lazyParsing  Defer parsing of all but the header fields
+	 *                     of received events until they are accessed.
+	 *                     See Event::CreateEventView().
+	 * \param subscriptions     Event factory subscriptions.  See
+	 *                          EventFactory::Subscribe().
+	 * \param numSubscriptions  The number of entries in subscriptions.
+	 */
 	Consumer(Event::BuildMethod *defBuilder = NULL,
 		 EventFactory::Record *regEntries = NULL,
-		 size_t numEntries = 0);
+		 size_t numEntries = 0,
+		 EventClock::Source clockSource = EventClock::PRECISE,
+		 bool lazyParsing = false,
+		 const EventFactory::Subscription *subscriptions = NULL,
+		 size_t numSubscriptions = 0);
 	virtual ~Consumer();
 
 	bool Connected() const;
@@ -81,16 +112,54 @@ public:
 	 */                                                              
 	void ReplayUnconsumedEvents(bool discardUnconsumed);
 
-	/** Return an event, if one is available.  */
+	/**
+	 * Return an event, if one is available.
+	 *
+	 * The returned event references the Consumer's receive buffer
+	 * rather than holding its own copy of the event data.  It must
+	 * be deleted before the next call to NextEvent() or NextEvents().
+	 * Use Event::Retain() to keep it beyond that point.
+	 */
 	Event *NextEvent();
 
 	/**
-	 * Extract events and invoke each event's Process method.
+	 * Return all events currently pending on the devd socket.
+	 * Every event in the batch shares a single receive time.
+	 *
+	 * \param events  List to which the extracted events are appended.
+	 *                As with NextEvent(), the events reference the
+	 *                Consumer's receive buffer.  Their handles must
+	 *                be dropped, and any events to be kept retained,
+	 *                before the next call to NextEvent() or
+	 *                NextEvents().
+	 *
+	 * \return  The number of event records read from the devd
+	 *          socket.  This may exceed the number of events
+	 *          appended, since records that do not produce an Event
+	 *          object (e.g. NOMATCH events) are discarded.
+	 */
+	size_t NextEvents(EventList &events);
+
+	/**
+	 * Extract events in batches and invoke each event's Process
+	 * method.
 	 */
 	void ProcessEvents();
 
-	/** Discard all data pending in m_devdSockFD. */
-	void FlushEvents();
+	/**
+	 * \brief Discard all data pending in m_devdSockFD.
+	 *
+	 * Records are dropped without being parsed or copied.
+	 *
+	 * \param discardedBytes  If not NULL, returns the number of
+	 *                        bytes discarded.  Where recv(2) does
+	 *                        not report the length of a truncated
+	 *                        record, this is the number of bytes
+	 *                        queued when the flush began.
+	 *
+	 * \returns  The number of records discarded.
+	 */
+	size_t FlushEvents(size_t *discardedBytes = NULL);
 
 	/**
 	 * Test for data pending in m_devdSockFD
@@ -112,23 +181,104 @@ public:
 	 */
 	void DisconnectFromDevd();
 
-	EventFactory GetFactory();
+	/**
+	 * \return  The factory used to build received events.  Its
+	 *          registry is fixed when the Consumer is constructed,
+	 *          so the reference may be shared for the Consumer's
+	 *          lifetime.
+	 */
+	const EventFactory &GetFactory() const;
+
+	/**
+	 * \return  The arena from which received events are allocated.
+	 *          Its counters show whether event processing has
+	 *          reached a steady state free of heap allocations.
+	 */
+	const EventArena &GetEventArena() const;
+
+	/**
+	 * \return  Per-system counts of events dropped by the ingress
+	 *          filter.  See FilterEvent().
+	 */
+	const DropCountList &GetDropCounts() const;
 
 protected:
 	/**
-	 * \brief Reads the most recent record
+	 * \brief Reads the most recent record into the receive buffer
+	 *
+	 * The record is stored at the given offset within m_recvBuf,
+	 * which must have at least RECORD_SLOT_SIZE bytes available
+	 * at that offset.
+	 *
+	 * On error, 0 is returned, and errno will be set by the OS
+	 *
+	 * \param offset  Offset into m_recvBuf at which to store the record.
+	 *
+	 * \returns  The length of the record.
+	 */
+	size_t ReadEvent(size_t offset);
+
+	/**
+	 * \brief Reads a batch of records into the receive buffer
+	 *
+	 * Records are stored in consecutive RECORD_SLOT_SIZE slots of
+	 * m_recvBuf, starting at the given offset.  Where recvmmsg(2) is
+	 * available the whole batch is received with a single system
+	 * call.  Otherwise records are read one at a time.  In either
+	 * case the read does not block once no records remain.
+	 *
+	 * \param offset      Offset into m_recvBuf of the first slot.
+	 * \param maxRecords  The maximum number of records to read.
+	 * \param lengths     Returns the length of each record read.
+	 *                    Must have room for maxRecords entries.
+	 *
+	 * \returns  The number of records read.  At most RECV_BATCH
+	 *           records are read by a single call.
+	 */
+	size_t ReadEvents(size_t offset, size_t maxRecords, size_t *lengths);
+
+	/**
+	 * Ensure that m_recvBuf has room for numSlots RECORD_SLOT_SIZE
+	 * slots at the given offset.  Views into m_recvBuf are invalidated
+	 * if it is resized.
+	 */
+	void ReserveRecordSlot(size_t offset, size_t numSlots = 1);
+
+	/**
+	 * \brief Ingress filter for received records
+	 *
+	 * Examines only the type and "system" field of a record.  Records
+	 * for which m_eventFactory has no build method are counted, by
+	 * system, in m_dropCounts and are never parsed.
 	 *
-	 * On error, "" is returned, and errno will be set by the OS
+	 * \param eventString  The received record.
 	 *
-	 * \returns      A string containing the record
+	 * \return  True if the record should be parsed into an Event.
 	 */
-	std::string ReadEvent();
+	bool FilterEvent(const StringView &eventString);
 
 	enum {
 		/*
 		 * The maximum event size supported by libdevctl.
 		 */
 		MAX_EVENT_SIZE = 8192,
+
+		/*
+		 * Space reserved in m_recvBuf for each record.
+		 */
+		RECORD_SLOT_SIZE = MAX_EVENT_SIZE,
+
+		/*
+		 * The maximum number of events read from devd
+		 * by a single call to NextEvents().
+		 */
+		MAX_BATCH_EVENTS = 256,
+
+		/*
+		 * The maximum number of records received by a single
+		 * call to ReadEvents().
+		 */
+		RECV_BATCH = 32
 	};
 
 	static const char  s_devdSockPath[];
@@ -154,6 +304,28 @@ protected:
 	/** Queued events for replay. */
 	EventList	   m_unconsumedEvents;
 
+	/**
+	 * Reusable storage for records received from devd.  Events
+	 * returned by NextEvent() and NextEvents() reference this
+	 * buffer until the next call to either method.
+	 */
+	std::vector<char>  m_recvBuf;
+
+	/** Source of receive times for received events. */
+	EventClock	   m_clock;
+
+	/** Create received events with deferred field parsing. */
+	bool		   m_lazyParsing;
+
+	/**
+	 * Storage for events returned by NextEvent() and NextEvents().
+	 * It is rewound once all of a batch's events are destroyed.
+	 */
+	EventArena	   m_eventArena;
+
+	/** Events dropped by FilterEvent(), by system. */
+	DropCountList	   m_dropCounts;
+
 	/**                                                             
 	 * Flag controlling whether events can be queued.  This boolean
 	 * is set during event replay to ensure that previosuly deferred
@@ -169,6 +341,24 @@ Consumer::Connected() const
 	return (m_devdSockFD != -1);
 }
 
+inline const EventFactory &
+Consumer::GetFactory() const
+{
+	return (m_eventFactory);
+}
+
+inline const EventArena &
+Consumer::GetEventArena() const
+{
+	return (m_eventArena);
+}
+
+inline const Consumer::DropCountList &
+Consumer::GetDropCounts() const
+{
+	return (m_dropCounts);
+}
+
 //- Consumer Public Inline Methods ---------------------------------------------
 inline int
 Consumer::GetPollFd()
@@ -176,11 +366,5 @@ Consumer::GetPollFd()
 	return (m_devdSockFD);
 }
 
-inline EventFactory
-Consumer::GetFactory()
-{
-	return (m_eventFactory);
-}
-
 } // namespace DevCtl
 #endif	/* _DEVCTL_CONSUMER_H_ */
@@ -48,18 +48,23 @@
 #include <paths.h>
 #include <stdlib.h>
 #include <syslog.h>
+#include <time.h>
 #include <unistd.h>
 
+#include <algorithm>
 #include <cstdarg>
 #include <cstring>
 #include <iostream>
 #include <list>
 #include <map>
-#include <sstream>
 #include <string>
+#include <vector>
 
 #include "guid.h"
+#include "string_view.h"
 #include "event.h"
+#include "event_arena.h"
+#include "event_clock.h"
 #include "event_factory.h"
 #include "exception.h"
 
@@ -70,18 +75,285 @@ __FBSDID("$FreeBSD$");
 
 /*============================ Namespace Control =============================*/
 using std::cout;
-using std::endl;
 using std::string;
-using std::stringstream;
 
 namespace DevCtl
 {
 
+/*============================ File Scoped Functions =========================*/
+/**
+ * \return  true if c separates the words of an event string.
+ */
+static inline bool
+IsFieldSeparator(char c)
+{
+	return (c == ' ' || c == '\t' || c == '\n');
+}
+
+/**
+ * \return  true if c may immediately precede the name of a name=value pair.
+ */
+static inline bool
+IsNameDelimiter(char c)
+{
+	return (c == '!' || IsFieldSeparator(c));
+}
+
+/**
+ * Append data to a formatted event, truncating it to fit the buffer.
+ *
+ * \param buf      The buffer holding the formatted event.
+ * \param size     The size of buf.  One byte is reserved for a NUL
+ *                 terminator.
+ * \param len      The length of the complete formatted event so far,
+ *                 which may exceed size.  Advanced by data's length.
+ * \param data     The data to append.
+ */
+static void
+FormatAppend(char *buf, size_t size, size_t &len, const StringView &data)
+{
+	if (len + 1 < size) {
+		size_t copyLen(std::min(data.length(), size - 1 - len));
+
+		memcpy(buf + len, data.data(), copyLen);
+	}
+	len += data.length();
+}
+
+/*============================ File Scoped Classes ===========================*/
+/**
+ * Owns a newly created NVPairMap until an Event adopts it, freeing
+ * the map if it is never adopted.
+ */
+class PendingMapGuard
+{
+public:
+	PendingMapGuard(NVPairMap &map)
+	 : m_map(&map)
+	{
+		map.SetPendingOwner(&m_map);
+	}
+
+	~PendingMapGuard()
+	{
+		if (m_map != NULL) {
+			m_map->SetPendingOwner(NULL);
+			delete m_map;
+		}
+	}
+
+	/**
+	 * Give up ownership without freeing the map, which may
+	 * already have been freed.
+	 */
+	void Release()
+	{
+		m_map = NULL;
+	}
+
+private:
+	/** The map, or NULL once it has been adopted or released. */
+	NVPairMap *m_map;
+};
+
 /*=========================== Class Implementations ==========================*/
+/*-------------------------------- NVPairMap ---------------------------------*/
+//- NVPairMap Static Private Data ----------------------------------------------
+#define KEY_RECORD(name) { name, sizeof(name) - 1 }
+const NVPairMap::KeyRecord NVPairMap::s_keyTable[] =
+{
+	KEY_RECORD("system"),
+	KEY_RECORD("subsystem"),
+	KEY_RECORD("type"),
+	KEY_RECORD("class"),
+	KEY_RECORD("pool_guid"),
+	KEY_RECORD("vdev_guid"),
+	KEY_RECORD("timestamp")
+};
+#undef KEY_RECORD
+
+//- NVPairMap Public Methods ---------------------------------------------------
+NVPairMap::NVPairMap(const StringView &base, EventArena *arena)
+ : m_base(base),
+   m_fields(NULL),
+   m_numFields(0),
+   m_maxFields(0),
+   m_arena(arena),
+   m_pendingOwner(NULL),
+   m_keysPresent(0),
+   m_unparsedOffset(StringView::npos)
+{
+}
+
+NVPairMap::NVPairMap(const NVPairMap &src)
+ : m_base(src.m_base),
+   m_fields(NULL),
+   m_numFields(src.m_numFields),
+   m_maxFields(src.m_numFields),
+   m_arena(NULL),
+   m_pendingOwner(NULL),
+   m_keysPresent(src.m_keysPresent),
+   m_unparsedOffset(src.m_unparsedOffset)
+{
+	if (m_numFields != 0) {
+		m_fields = static_cast<Field *>(
+		    EventArena::Allocate(m_arena, m_maxFields * sizeof(Field)));
+		memcpy(m_fields, src.m_fields, m_numFields * sizeof(Field));
+	}
+	memcpy(m_keyValues, src.m_keyValues, sizeof(m_keyValues));
+}
+
+NVPairMap::~NVPairMap()
+{
+	EventArena::Free(m_fields);
+}
+
+void *
+NVPairMap::operator new(size_t size)
+{
+	return (EventArena::Allocate(/*arena*/NULL, size));
+}
+
+void *
+NVPairMap::operator new(size_t size, EventArena *arena)
+{
+	return (EventArena::Allocate(arena, size));
+}
+
+void
+NVPairMap::operator delete(void *addr)
+{
+	EventArena::Free(addr);
+}
+
+void
+NVPairMap::operator delete(void *addr, EventArena *)
+{
+	EventArena::Free(addr);
+}
+
+EventArena *
+NVPairMap::GetArena() const
+{
+	return (m_arena);
+}
+
+void
+NVPairMap::SetPendingOwner(NVPairMap **owner)
+{
+	m_pendingOwner = owner;
+}
+
+void
+NVPairMap::Adopt()
+{
+	if (m_pendingOwner != NULL)
+		*m_pendingOwner = NULL;
+	m_pendingOwner = NULL;
+}
+
+void
+NVPairMap::Add(const StringView &name, const StringView &value)
+{
+	size_t	 index(LowerBound(name));
+	Range	 valueRange(ToRange(value));
+	EventKey key(LookupKey(name));
+
+	if (key != NUM_EVENT_KEYS) {
+		m_keyValues[key] = valueRange;
+		m_keysPresent |= 1U << key;
+	}
+
+	if (index < m_numFields && ToView(m_fields[index].m_name) == name) {
+		m_fields[index].m_value = valueRange;
+		return;
+	}
+
+	if (m_numFields == m_maxFields)
+		Grow();
+	memmove(&m_fields[index + 1], &m_fields[index],
+		(m_numFields - index) * sizeof(Field));
+	m_fields[index].m_name  = ToRange(name);
+	m_fields[index].m_value = valueRange;
+	m_numFields++;
+}
+
+NVPairMap::const_iterator
+NVPairMap::find(const StringView &name) const
+{
+	size_t index(LowerBound(name));
+
+	if (index < m_numFields && ToView(m_fields[index].m_name) == name)
+		return (const_iterator(this, index));
+	return (end());
+}
+
+//- NVPairMap Static Public Methods --------------------------------------------
+EventKey
+NVPairMap::LookupKey(const StringView &name)
+{
+	for (int key(0); key < NUM_EVENT_KEYS; key++) {
+		const KeyRecord &rec(s_keyTable[key]);
+
+		if (rec.m_length == name.length()
+		 && memcmp(rec.m_name, name.data(), name.length()) == 0)
+			return (static_cast<EventKey>(key));
+	}
+	return (NUM_EVENT_KEYS);
+}
+
+//- NVPairMap Private Methods --------------------------------------------------
+void
+NVPairMap::Grow()
+{
+	size_t maxFields(m_maxFields == 0 ? (size_t)INITIAL_FIELDS
+					   : m_maxFields * 2);
+	Field *fields(static_cast<Field *>(
+	    EventArena::Allocate(m_arena, maxFields * sizeof(Field))));
+
+	if (m_numFields != 0)
+		memcpy(fields, m_fields, m_numFields * sizeof(Field));
+	EventArena::Free(m_fields);
+	m_fields    = fields;
+	m_maxFields = maxFields;
+}
+
+NVPairMap::Range
+NVPairMap::ToRange(const StringView &view) const
+{
+	Range range;
+
+	range.m_length = view.length();
+	if (view.data() >= m_base.data()
+	 && view.data() + view.length() <= m_base.data() + m_base.length()) {
+		range.m_static = NULL;
+		range.m_offset = view.data() - m_base.data();
+	} else {
+		range.m_static = view.data();
+		range.m_offset = 0;
+	}
+	return (range);
+}
+
+size_t
+NVPairMap::LowerBound(const StringView &name) const
+{
+	size_t low(0);
+	size_t high(m_numFields);
+
+	while (low < high) {
+		size_t mid(low + (high - low) / 2);
+
+		if (ToView(m_fields[mid].m_name) < name)
+			low = mid + 1;
+		else
+			high = mid;
+	}
+	return (low);
+}
+
 /*----------------------------------- Event ----------------------------------*/
 //- Event Static Protected Data ------------------------------------------------
-const string Event::s_theEmptyString;
-
 Event::EventTypeRecord Event::s_typeTable[] =
 {
 	{ Event::NOTIFY,  "Notify" },
@@ -90,25 +362,56 @@ Event::EventTypeRecord Event::s_typeTable[] =
 	{ Event::DETACH,  "Detach" }
 };
 
+uint64_t Event::s_unparsedEventCount;
+
 //- Event Static Public Methods ------------------------------------------------
 Event *
 Event::Builder(Event::Type type, NVPairMap &nvPairs,
-	       const string &eventString)
+	       const StringView &eventString)
 {
-	return (new Event(type, nvPairs, eventString));
+	return (new (nvPairs.GetArena()) Event(type, nvPairs, eventString));
 }
 
 Event *
 Event::CreateEvent(const EventFactory &factory, const string &eventString)
 {
-	NVPairMap &nvpairs(*new NVPairMap);
-	Type       type(static_cast<Event::Type>(eventString[0]));
+	Event *event(CreateEventView(factory, eventString));
+
+	if (event != NULL)
+		event->RetainEventString();
+	return (event);
+}
+
+Event *
+Event::CreateEventView(const EventFactory &factory,
+		       const StringView &eventString, bool lazy,
+		       EventArena *arena, EventClock *clock)
+{
+	if (eventString.empty())
+		return (NULL);
+
+	/*
+	 * Events of types that are never built, such as NOMATCH, can
+	 * arrive in floods.  Reject them before doing any other work.
+	 */
+	Type type(static_cast<Event::Type>(eventString[0]));
+	if (CheckType(type) != PARSE_OK)
+		return (NULL);
+
+	NVPairMap &nvpairs(*new (arena) NVPairMap(eventString, arena));
+
+	/*
+	 * The map is owned here until an Event adopts it.  Should
+	 * parsing, or building the event, fail before then, the guard
+	 * frees the map and its hold on the arena.
+	 */
+	PendingMapGuard pending(nvpairs);
 
 	try {
-		ParseEventString(type, eventString, nvpairs);
+		ParseEventString(type, eventString, nvpairs,
+				 /*headerOnly*/lazy);
 	} catch (const ParseException &exp) {
-		if (exp.GetType() == ParseException::INVALID_FORMAT)
-			exp.Log();
+		exp.Log();
 		return (NULL);
 	}
 
@@ -116,11 +419,148 @@ Event::CreateEvent(const EventFactory &factory, const string &eventString)
 	 * Allow entries in our table for events with no system specified.
 	 * These entries should specify the string "none".
 	 */
-	NVPairMap::iterator system_item(nvpairs.find("system"));
-	if (system_item == nvpairs.end())
-		nvpairs["system"] = "none";
+	if (!nvpairs.Contains(KEY_SYSTEM))
+		nvpairs.Add("system", "none");
+
+	bool   deferred(!nvpairs.FullyParsed());
+	Event *event;
 
-	return (factory.Build(type, nvpairs, eventString));
+	event = factory.Build(type, nvpairs, eventString);
+
+	/* The map is now owned by the event, or was freed by the factory. */
+	pending.Release();
+
+	if (event == NULL) {
+		if (deferred)
+			s_unparsedEventCount++;
+	} else if (clock != NULL) {
+		/*
+		 * The receive time is held as a typed member, rather than
+		 * being added to the event data, so the data is never
+		 * modified.  It is only read from the clock if the event
+		 * may need it.
+		 */
+		event->m_receiveTime = clock->ReceiveTime();
+		event->m_haveReceiveTime = true;
+		if (!event->m_haveTimestamp)
+			event->m_timestamp = clock->Now();
+	}
+	return (event);
+}
+
+timespec
+Event::ParseTimestamp(const StringView &value)
+{
+	timespec   timestamp;
+	size_t	   i(0);
+
+	/*
+	 * Timestamps are recorded as seconds since the Epoch,
+	 * optionally followed by a fraction of a second.
+	 */
+	timestamp.tv_sec  = 0;
+	timestamp.tv_nsec = 0;
+	for (; i < value.length() && isdigit(value[i]); i++)
+		timestamp.tv_sec = timestamp.tv_sec * 10 + (value[i] - '0');
+
+	if (i < value.length() && value[i] == '.') {
+		long scale(100000000);
+
+		for (i++; i < value.length() && isdigit(value[i]); i++) {
+			timestamp.tv_nsec += (value[i] - '0') * scale;
+			scale /= 10;
+		}
+	}
+	return (timestamp);
+}
+
+void *
+Event::operator new(size_t size)
+{
+	return (EventArena::Allocate(/*arena*/NULL, size));
+}
+
+void *
+Event::operator new(size_t size, EventArena *arena)
+{
+	return (EventArena::Allocate(arena, size));
+}
+
+void
+Event::operator delete(void *addr)
+{
+	EventArena::Free(addr);
+}
+
+void
+Event::operator delete(void *addr, EventArena *)
+{
+	EventArena::Free(addr);
+}
+
+Event::ParseStatus
+Event::CheckType(Type type)
+{
+	switch (type) {
+	case NOTIFY:
+	case ATTACH:
+	case DETACH:
+		return (PARSE_OK);
+	case NOMATCH:
+		return (PARSE_DISCARDED);
+	default:
+		return (PARSE_UNKNOWN_TYPE);
+	}
+}
+
+bool
+Event::PeekField(const StringView &eventString, const StringView &name,
+		 StringView &value)
+{
+	const size_t keyLen(name.length() + 1);
+	const char  *data(eventString.data());
+	const char  *end(data + eventString.length());
+	const char  *cur(data);
+	bool	     found(false);
+
+	if (name.empty())
+		return (false);
+
+	/*
+	 * Candidates are located by the first character of the name.
+	 * A match must start a field and be followed by '='.  As when
+	 * the event is parsed, the last occurrence of a field wins.
+	 */
+	while ((size_t)(end - cur) >= keyLen
+	    && (cur = static_cast<const char *>(
+			memchr(cur, name[0], end - cur - keyLen + 1)))
+	       != NULL) {
+		if ((cur == data || IsNameDelimiter(cur[-1]))
+		 && cur[keyLen - 1] == '='
+		 && memcmp(cur, name.data(), keyLen - 1) == 0) {
+			const char *valueStart(cur + keyLen);
+			const char *valueEnd(valueStart);
+
+			while (valueEnd < end && !IsFieldSeparator(*valueEnd))
+				valueEnd++;
+			value = StringView(valueStart, valueEnd - valueStart);
+			found = true;
+			cur = valueEnd;
+		} else {
+			cur++;
+		}
+	}
+	return (found);
+}
+
+StringView
+Event::PeekSystem(const StringView &eventString)
+{
+	StringView system;
+
+	if (!PeekField(eventString, "system", system))
+		return (StringView("none"));
+	return (system);
 }
 
 const char *
@@ -137,49 +577,79 @@ Event::TypeToString(Event::Type type)
 }
 
 //- Event Public Methods -------------------------------------------------------
-const string &
-Event::Value(const string &varName) const
+StringView
+Event::Value(const StringView &varName) const
 {
+	ParseDeferredFields();
+
 	NVPairMap::const_iterator item(m_nvPairs.find(varName));
 	if (item == m_nvPairs.end())
-		return (s_theEmptyString);
+		return (StringView());
 
 	return (item->second);
 }
 
 bool
-Event::Contains(const string &varName) const
+Event::Contains(const StringView &varName) const
 {
+	ParseDeferredFields();
 	return (m_nvPairs.find(varName) != m_nvPairs.end());
 }
 
 string
 Event::ToString() const
 {
-	stringstream result;
+	char   buf[LOG_BUFFER_SIZE];
+	size_t len(Format(buf, sizeof(buf)));
+
+	if (len < sizeof(buf))
+		return (string(buf, len));
+
+	string result(len + 1, '\0');
+
+	Format(&result[0], result.size());
+	result.resize(len);
+	return (result);
+}
+
+size_t
+Event::Format(char *buf, size_t size) const
+{
+	size_t len(0);
+
+	ParseDeferredFields();
 
 	NVPairMap::const_iterator devName(m_nvPairs.find("device-name"));
-	if (devName != m_nvPairs.end())
-		result << devName->second << ": ";
+	if (devName != m_nvPairs.end()) {
+		FormatAppend(buf, size, len, devName->second);
+		FormatAppend(buf, size, len, ": ");
+	}
 
 	NVPairMap::const_iterator systemName(m_nvPairs.find("system"));
 	if (systemName != m_nvPairs.end()
-	 && systemName->second != "none")
-		result << systemName->second << ": ";
+	 && systemName->second != "none") {
+		FormatAppend(buf, size, len, systemName->second);
+		FormatAppend(buf, size, len, ": ");
+	}
 
-	result << TypeToString(GetType()) << ' ';
+	FormatAppend(buf, size, len, TypeToString(GetType()));
+	FormatAppend(buf, size, len, " ");
 
 	for (NVPairMap::const_iterator curVar = m_nvPairs.begin();
 	     curVar != m_nvPairs.end(); curVar++) {
 		if (curVar == devName || curVar == systemName)
 			continue;
 
-		result << ' '
-		     << curVar->first << "=" << curVar->second;
+		FormatAppend(buf, size, len, " ");
+		FormatAppend(buf, size, len, curVar->first);
+		FormatAppend(buf, size, len, "=");
+		FormatAppend(buf, size, len, curVar->second);
 	}
-	result << endl;
+	FormatAppend(buf, size, len, "\n");
 
-	return (result.str());
+	if (size != 0)
+		buf[std::min(len, size - 1)] = '\0';
+	return (len);
 }
 
 void
@@ -191,12 +661,23 @@ Event::Print() const
 void
 Event::Log(int priority) const
 {
-	syslog(priority, "%s", ToString().c_str());
+	char buf[LOG_BUFFER_SIZE];
+
+	Format(buf, sizeof(buf));
+	syslog(priority, "%s", buf);
 }
 
 //- Event Virtual Public Methods -----------------------------------------------
 Event::~Event()
 {
+	/*
+	 * A retained copy carries the unparsed offset with it and
+	 * accounts for this record when it is destroyed.
+	 */
+	if (m_retainedCopy != NULL)
+		m_retainedCopy->Release();
+	else if (!m_nvPairs.FullyParsed())
+		s_unparsedEventCount++;
 	delete &m_nvPairs;
 }
 
@@ -206,52 +687,147 @@ Event::DeepCopy() const
 	return (new Event(*this));
 }
 
+EventHandle
+Event::Retain() const
+{
+	const Event *retained(this);
+
+	if (m_eventStorage.empty()) {
+		/* A view.  Its data must be copied before it can be kept. */
+		if (m_retainedCopy == NULL)
+			m_retainedCopy = DeepCopy();
+		retained = m_retainedCopy;
+	}
+	retained->Hold();
+	return (EventHandle(retained));
+}
+
 bool
 Event::Process() const
 {
 	return (false);
 }
 
-timeval
+const timespec &
 Event::GetTimestamp() const
 {
-	timeval tv_timestamp;
-	struct tm tm_timestamp;
-
-	if (!Contains("timestamp")) {
-		throw Exception("Event contains no timestamp: %s",
-				m_eventString.c_str());
+	if (!m_haveTimestamp) {
+		if (Contains(KEY_TIMESTAMP)) {
+			m_timestamp = ParseTimestamp(Value(KEY_TIMESTAMP));
+		} else if (!m_haveReceiveTime) {
+			throw Exception("Event contains no timestamp: %.*s",
+					(int)m_eventString.length(),
+					m_eventString.data());
+		}
+		m_haveTimestamp = true;
 	}
-	strptime(Value(string("timestamp")).c_str(), "%s", &tm_timestamp);
-	tv_timestamp.tv_sec = mktime(&tm_timestamp);
-	tv_timestamp.tv_usec = 0;
-	return (tv_timestamp);
+	return (m_timestamp);
 }
 
+void
+Event::SetTimestamp(const timespec &timestamp)
+{
+	m_timestamp = timestamp;
+	m_haveTimestamp = true;
+}
+
+timespec
+Event::GetAge() const
+{
+	timespec now;
+	timespec then;
+	timespec age;
+
+	if (m_haveReceiveTime) {
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		then = m_receiveTime;
+	} else {
+		then = GetTimestamp();
+		clock_gettime(CLOCK_REALTIME, &now);
+	}
+
+	age.tv_sec  = now.tv_sec - then.tv_sec;
+	age.tv_nsec = now.tv_nsec - then.tv_nsec;
+	if (age.tv_nsec < 0) {
+		age.tv_sec--;
+		age.tv_nsec += 1000000000;
+	}
+	if (age.tv_sec < 0) {
+		age.tv_sec  = 0;
+		age.tv_nsec = 0;
+	}
+	return (age);
+}
 
 //- Event Protected Methods ----------------------------------------------------
-Event::Event(Type type, NVPairMap &map, const string &eventString)
+Event::Event(Type type, NVPairMap &map, const StringView &eventString)
  : m_type(type),
    m_nvPairs(map),
-   m_eventString(eventString)
+   m_eventString(eventString),
+   m_haveTimestamp(false),
+   m_haveReceiveTime(false),
+   m_refCount(1),
+   m_retainedCopy(NULL)
 {
+	m_timestamp.tv_sec    = 0;
+	m_timestamp.tv_nsec   = 0;
+	m_receiveTime.tv_sec  = 0;
+	m_receiveTime.tv_nsec = 0;
+	m_nvPairs.Adopt();
+
+	/*
+	 * Convert the timestamp now if it has already been parsed.
+	 * Otherwise it is converted on first use, so that lazily
+	 * parsed events that are never examined stay cheap.
+	 */
+	if (m_nvPairs.Contains(KEY_TIMESTAMP)) {
+		m_timestamp = ParseTimestamp(m_nvPairs.Value(KEY_TIMESTAMP));
+		m_haveTimestamp = true;
+	}
 }
 
 Event::Event(const Event &src)
  : m_type(src.m_type),
    m_nvPairs(*new NVPairMap(src.m_nvPairs)),
-   m_eventString(src.m_eventString)
+   m_eventStorage(src.m_eventString.data(), src.m_eventString.length()),
+   m_eventString(m_eventStorage),
+   m_timestamp(src.m_timestamp),
+   m_haveTimestamp(src.m_haveTimestamp),
+   m_receiveTime(src.m_receiveTime),
+   m_haveReceiveTime(src.m_haveReceiveTime),
+   m_refCount(1),
+   m_retainedCopy(NULL)
 {
+	m_nvPairs.Rebase(m_eventString);
 }
 
+//- Event Private Methods ------------------------------------------------------
 void
-Event::ParseEventString(Event::Type type,
-			      const string &eventString,
-			      NVPairMap& nvpairs)
+Event::RetainEventString()
 {
-	size_t start;
-	size_t end;
+	m_eventStorage.assign(m_eventString.data(), m_eventString.length());
+	m_eventString = StringView(m_eventStorage);
+	m_nvPairs.Rebase(m_eventString);
+}
 
+void
+Event::ParseRemainingFields() const
+{
+	try {
+		ParseFields(m_type, m_eventString, m_nvPairs.UnparsedOffset(),
+			    m_nvPairs, /*headerOnly*/false);
+	} catch (const ParseException &exp) {
+		/* Keep the fields parsed before the error. */
+		exp.Log();
+		m_nvPairs.SetUnparsedOffset(StringView::npos);
+	}
+}
+
+void
+Event::ParseEventString(Event::Type type,
+			      const StringView &eventString,
+			      NVPairMap& nvpairs, bool headerOnly)
+{
 	switch (type) {
 	case ATTACH:
 	case DETACH:
@@ -261,107 +837,120 @@ Event::ParseEventString(Event::Type type,
 		 *                        at <location vars> <pnpvars> \
 		 *                        on <parent>
 		 *
-		 * Handle all data that doesn't conform to the
-		 * "name=value" format, and let the generic parser
-		 * below handle the rest.
+		 * The first word is the device name, and the word
+		 * following " on " names the parent.  All other data
+		 * is handled by the generic "name=value" parsing.
 		 *
-		 * Type is a single char.  Skip it.
+		 * An empty device name must still be followed by data.
 		 */
-		start = 1;
-		end = eventString.find_first_of(" \t\n", start);
-		if (end == string::npos)
+		if (eventString.length() <= 1)
 			throw ParseException(ParseException::INVALID_FORMAT,
-					     eventString, start);
-
-		nvpairs["device-name"] = eventString.substr(start, end - start);
+					     eventString.str(), 1);
+		if (IsFieldSeparator(eventString[1]))
+			nvpairs.Add("device-name", eventString.substr(1, 0));
 
-		start = eventString.find(" on ", end);
-		if (end == string::npos)
-			throw ParseException(ParseException::INVALID_FORMAT,
-					     eventString, start);
-		start += 4;
-		end = eventString.find_first_of(" \t\n", start);
-		nvpairs["parent"] = eventString.substr(start, end);
-		break;
-	case NOTIFY:
+		/* Only NOTIFY events have header fields. */
+		headerOnly = false;
 		break;
-	case NOMATCH:
-		throw ParseException(ParseException::DISCARDED_EVENT_TYPE,
-				     eventString);
 	default:
-		throw ParseException(ParseException::UNKNOWN_EVENT_TYPE,
-				     eventString);
+		break;
 	}
 
-	/* Process common "key=value" format. */
-	for (start = 1; start < eventString.length(); start = end + 1) {
+	/* Type is a single char.  Skip it. */
+	ParseFields(type, eventString, 1, nvpairs, headerOnly);
+}
+
+void
+Event::ParseFields(Event::Type type, const StringView &eventString,
+		   size_t start, NVPairMap &nvpairs, bool headerOnly)
+{
+	const char *data(eventString.data());
+	size_t	    length(eventString.length());
+	bool	    attachDetach(type == ATTACH || type == DETACH);
+	bool	    sawOn(false);
+	bool	    parentPending(false);
 
-		/* Find the '=' in the middle of the key/value pair. */
-		end = eventString.find('=', start);
-		if (end == string::npos)
+	/*
+	 * Walk the event a single time, a word at a time.  Words are
+	 * separated by whitespace.  A word containing an '=' holds a
+	 * "name=value" pair.  The name starts after the last '!' before
+	 * the '=', and the value runs to the end of the word.
+	 */
+	for (size_t pos(start); pos < length;) {
+		size_t wordStart;
+		size_t nameStart;
+		size_t equals(StringView::npos);
+
+		while (pos < length && IsFieldSeparator(data[pos]))
+			pos++;
+		if (pos >= length)
 			break;
 
+		wordStart = nameStart = pos;
+		for (; pos < length && !IsFieldSeparator(data[pos]); pos++) {
+			if (equals != StringView::npos)
+				continue;
+			if (data[pos] == '=')
+				equals = pos;
+			else if (data[pos] == '!')
+				nameStart = pos + 1;
+		}
+
+		StringView word(data + wordStart, pos - wordStart);
+		if (attachDetach) {
+			if (wordStart == 1) {
+				/* The device name must be followed by data. */
+				if (pos >= length)
+					throw ParseException(
+					    ParseException::INVALID_FORMAT,
+					    eventString.str(), wordStart);
+				nvpairs.Add("device-name", word);
+			} else if (parentPending) {
+				nvpairs.Add("parent", word);
+				parentPending = false;
+			} else if (!sawOn && word == "on"
+				&& data[wordStart - 1] == ' '
+				&& pos < length && data[pos] == ' ') {
+				sawOn = true;
+				parentPending = true;
+			}
+		}
+
+		if (equals == StringView::npos)
+			continue;
+
 		/*
-		 * Find the start of the key by backing up until
-		 * we hit whitespace or '!' (event type "notice").
-		 * Due to the devctl format, all key/value pair must
-		 * start with one of these two characters.
+		 * Due to the devctl format, all name/value pairs must
+		 * be preceded by whitespace or '!' (event type "notice").
 		 */
-		start = eventString.find_last_of("! \t\n", end);
-		if (start == string::npos)
+		if (nameStart == 1 && !IsNameDelimiter(data[0]))
 			throw ParseException(ParseException::INVALID_FORMAT,
-					     eventString, end);
-		start++;
-		string key(eventString.substr(start, end - start));
+					     eventString.str(), equals);
 
-		/*
-		 * Walk forward from the '=' until either we exhaust
-		 * the buffer or we hit whitespace.
-		 */
-		start = end + 1;
-		if (start >= eventString.length())
+		/* A value must follow the '='. */
+		if (equals + 1 >= length)
 			throw ParseException(ParseException::INVALID_FORMAT,
-					     eventString, end);
-		end = eventString.find_first_of(" \t\n", start);
-		if (end == string::npos)
-			end = eventString.length() - 1;
-		string value(eventString.substr(start, end - start));
+					     eventString.str(), equals);
 
-		nvpairs[key] = value;
-	}
-}
+		nvpairs.Add(StringView(data + nameStart, equals - nameStart),
+			    StringView(data + equals + 1, pos - equals - 1));
 
-void
-Event::TimestampEventString(std::string &eventString)
-{
-	if (eventString.size() > 0) {
-		/*
-		 * Add a timestamp as the final field of the event if it is
-		 * not already present.
-		 */
-		if (eventString.find("timestamp=") == string::npos) {
-			const size_t bufsize = 32;	// Long enough for a 64-bit int
-			timeval now;
-			struct tm* time_s;
-			char timebuf[bufsize];
-
-			size_t eventEnd(eventString.find_last_not_of('\n') + 1);
-			if (gettimeofday(&now, NULL) != 0)
-				err(1, "gettimeofday");
-			time_s = gmtime(&now.tv_sec);
-			strftime(timebuf, bufsize, " timestamp=%s", time_s);
-			eventString.insert(eventEnd, timebuf);
+		if (headerOnly && pos < length && nvpairs.HaveHeader()) {
+			nvpairs.SetUnparsedOffset(pos);
+			return;
 		}
 	}
+	nvpairs.SetUnparsedOffset(StringView::npos);
 }
 
 /*-------------------------------- DevfsEvent --------------------------------*/
 //- DevfsEvent Static Public Methods -------------------------------------------
 Event *
 DevfsEvent::Builder(Event::Type type, NVPairMap &nvPairs,
-		    const string &eventString)
+		    const StringView &eventString)
 {
-	return (new DevfsEvent(type, nvPairs, eventString));
+	return (new (nvPairs.GetArena())
+	    DevfsEvent(type, nvPairs, eventString));
 }
 
 //- DevfsEvent Static Protected Methods ----------------------------------------
@@ -460,10 +1049,10 @@ DevfsEvent::IsWholeDev() const
 bool
 DevfsEvent::DevName(std::string &name) const
 {
-	if (Value("subsystem") != "CDEV")
+	if (Value(KEY_SUBSYSTEM) != "CDEV")
 		return (false);
 
-	name = Value("cdev");
+	name = Value("cdev").str();
 	return (!name.empty());
 }
 
@@ -512,7 +1101,7 @@ DevfsEvent::PhysicalPath(std::string &path) const
 
 //- DevfsEvent Protected Methods -----------------------------------------------
 DevfsEvent::DevfsEvent(Event::Type type, NVPairMap &nvpairs,
-		       const string &eventString)
+		       const StringView &eventString)
  : Event(type, nvpairs, eventString)
 {
 }
@@ -523,12 +1112,61 @@ DevfsEvent::DevfsEvent(const DevfsEvent &src)
 }
 
 /*--------------------------------- ZfsEvent ---------------------------------*/
+//- ZfsEvent Static Protected Data ---------------------------------------------
+/*
+ * Each entry must sit in the slot given by KindHash() for its name.
+ * The zfsd unit tests verify that every entry classifies correctly.
+ */
+#define KIND_RECORD(name, kind) { name, sizeof(name) - 1, kind }
+#define EMPTY_KIND_RECORD { NULL, 0, UNKNOWN_KIND }
+const ZfsEvent::KindRecord ZfsEvent::s_kindTable[KIND_TABLE_SIZE] =
+{
+	/*  0 */ KIND_RECORD("ereport.fs.zfs.checksum", CHECKSUM_EREPORT),
+	/*  1 */ KIND_RECORD("misc.fs.zfs.pool_destroy", POOL_DESTROY),
+	/*  2 */ EMPTY_KIND_RECORD,
+	/*  3 */ EMPTY_KIND_RECORD,
+	/*  4 */ KIND_RECORD("ereport.fs.zfs.io", IO_EREPORT),
+	/*  5 */ EMPTY_KIND_RECORD,
+	/*  6 */ KIND_RECORD("misc.fs.zfs.config_sync", CONFIG_SYNC),
+	/*  7 */ KIND_RECORD("resource.fs.zfs.removed", VDEV_REMOVED),
+	/*  8 */ KIND_RECORD("misc.fs.zfs.vdev_remove", VDEV_REMOVE),
+	/*  9 */ EMPTY_KIND_RECORD,
+	/* 10 */ EMPTY_KIND_RECORD,
+	/* 11 */ EMPTY_KIND_RECORD,
+	/* 12 */ KIND_RECORD("resource.fs.zfs.statechange", VDEV_STATECHANGE),
+	/* 13 */ EMPTY_KIND_RECORD,
+	/* 14 */ KIND_RECORD("ereport.fs.zfs.vdev.no_replicas",
+			     NO_REPLICAS_EREPORT),
+	/* 15 */ KIND_RECORD("misc.fs.zfs.resilver_finish", RESILVER_FINISH)
+};
+#undef EMPTY_KIND_RECORD
+#undef KIND_RECORD
+
 //- ZfsEvent Static Public Methods ---------------------------------------------
 Event *
 ZfsEvent::Builder(Event::Type type, NVPairMap &nvpairs,
-		  const string &eventString)
+		  const StringView &eventString)
+{
+	return (new (nvpairs.GetArena()) ZfsEvent(type, nvpairs, eventString));
+}
+
+ZfsEvent::Kind
+ZfsEvent::Classify(const StringView &name)
 {
-	return (new ZfsEvent(type, nvpairs, eventString));
+	static const StringView poolEventPrefix("misc.fs.zfs.");
+
+	if (name.empty())
+		return (UNKNOWN_KIND);
+
+	const KindRecord &rec(s_kindTable[KindHash(name)]);
+	if (rec.m_name != NULL
+	 && StringView(rec.m_name, rec.m_length) == name)
+		return (rec.m_kind);
+
+	if (name.substr(0, poolEventPrefix.length()) == poolEventPrefix)
+		return (OTHER_POOL_EVENT);
+
+	return (UNKNOWN_KIND);
 }
 
 //- ZfsEvent Virtual Public Methods --------------------------------------------
@@ -538,17 +1176,30 @@ ZfsEvent::DeepCopy() const
 	return (new ZfsEvent(*this));
 }
 
+//- ZfsEvent Static Protected Methods ------------------------------------------
+size_t
+ZfsEvent::KindHash(const StringView &name)
+{
+	unsigned char last(name[name.length() - 1]);
+
+	return ((name.length() * 5 + last) & (KIND_TABLE_SIZE - 1));
+}
+
 //- ZfsEvent Protected Methods -------------------------------------------------
 ZfsEvent::ZfsEvent(Event::Type type, NVPairMap &nvpairs,
-		   const string &eventString)
+		   const StringView &eventString)
  : Event(type, nvpairs, eventString),
-   m_poolGUID(Guid(Value("pool_guid"))),
-   m_vdevGUID(Guid(Value("vdev_guid")))
+   m_kind(Classify(Value(KEY_TYPE))),
+   m_poolGUID(Value(KEY_POOL_GUID).data(), Value(KEY_POOL_GUID).length()),
+   m_vdevGUID(Value(KEY_VDEV_GUID).data(), Value(KEY_VDEV_GUID).length())
 {
+	if (m_kind == UNKNOWN_KIND)
+		m_kind = Classify(Value(KEY_CLASS));
 }
 
 ZfsEvent::ZfsEvent(const ZfsEvent &src)
  : Event(src),
+   m_kind(src.m_kind),
    m_poolGUID(src.m_poolGUID),
    m_vdevGUID(src.m_vdevGUID)
 {
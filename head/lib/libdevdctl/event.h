@@ -47,14 +47,434 @@ namespace DevCtl
 {
 
 /*=========================== Forward Declarations ===========================*/
+class EventArena;
+class EventClock;
 class EventFactory;
+class EventHandle;
 
 /*============================= Class Definitions ============================*/
+/*--------------------------------- EventKey ---------------------------------*/
+/**
+ * Well known event field names.  These fields are located while an
+ * event is parsed, so that their values can be retrieved without a
+ * search by name.
+ *
+ * The header keys, KEY_SYSTEM through KEY_TYPE, are those used to
+ * route an event.  They are always parsed, even when the parsing of
+ * other fields is deferred.
+ */
+enum EventKey {
+	KEY_SYSTEM,
+	KEY_SUBSYSTEM,
+	KEY_TYPE,
+	KEY_LAST_HEADER = KEY_TYPE,
+	KEY_CLASS,
+	KEY_POOL_GUID,
+	KEY_VDEV_GUID,
+	KEY_TIMESTAMP,
+	NUM_EVENT_KEYS
+};
+
 /*-------------------------------- NVPairMap ---------------------------------*/
 /**
- * NVPairMap is a specialization of the standard map STL container.
+ * \brief Compact name => value storage for the fields of an event.
+ *
+ * Names and values are not copied.  Each field is recorded as a pair
+ * of offset/length ranges into a base string, normally the event
+ * string from which the fields were parsed, and fields are kept sorted
+ * by name.  Populating the map therefore costs no per-field allocation,
+ * and the map can be moved to a copy of its base string by Rebase().
+ *
+ * Synthesized names and values that are not part of the base string,
+ * such as the "device-name" of ATTACH events, must reference static
+ * storage.  They are stored by address and are unaffected by Rebase().
  */
-typedef std::map<std::string, std::string> NVPairMap;
+class NVPairMap
+{
+public:
+	/** A name => value pair, as exposed by const_iterator. */
+	struct value_type
+	{
+		StringView first;
+		StringView second;
+	};
+
+	/** Iterates over the fields of an NVPairMap in name order. */
+	class const_iterator
+	{
+	public:
+		const_iterator();
+		const_iterator(const NVPairMap *map, size_t index);
+
+		const value_type &operator*()			const;
+		const value_type *operator->()			const;
+		const_iterator	 &operator++();
+		const_iterator	  operator++(int);
+		bool operator==(const const_iterator &rhs)	const;
+		bool operator!=(const const_iterator &rhs)	const;
+
+	private:
+		const NVPairMap	  *m_map;
+		size_t		   m_index;
+		mutable value_type m_value;
+	};
+
+	/**
+	 * Constructor
+	 *
+	 * \param base   The string referenced by all fields of this map.
+	 * \param arena  The arena from which to allocate the field list,
+	 *               or NULL to allocate it from the heap.
+	 */
+	explicit NVPairMap(const StringView &base = StringView(),
+			   EventArena *arena = NULL);
+
+	/**
+	 * Copy constructor.  The copy's field list is allocated from
+	 * the heap, regardless of the source of the original's.
+	 */
+	NVPairMap(const NVPairMap &src);
+
+	/** Destructor */
+	~NVPairMap();
+
+	/** Allocate a map from the heap. */
+	static void *operator new(size_t size);
+
+	/**
+	 * Allocate a map from an arena.
+	 *
+	 * \param size   The size of the map.
+	 * \param arena  The arena to allocate from, or NULL for the heap.
+	 */
+	static void *operator new(size_t size, EventArena *arena);
+
+	static void operator delete(void *addr);
+	static void operator delete(void *addr, EventArena *arena);
+
+	/**
+	 * \return  The arena holding this map's fields, or NULL for
+	 *          the heap.  Events built from the map are allocated
+	 *          from the same arena.
+	 */
+	EventArena *GetArena()					const;
+
+	/**
+	 * Register a pointer that owns this map until an Event takes
+	 * ownership of it.  The pointer is cleared by Adopt().
+	 *
+	 * \param owner  The pointer to clear, or NULL.
+	 */
+	void SetPendingOwner(NVPairMap **owner);
+
+	/**
+	 * Record that an Event has taken ownership of this map,
+	 * clearing any pointer registered with SetPendingOwner().
+	 */
+	void Adopt();
+
+	/**
+	 * Record a name => value pair, replacing any existing value
+	 * for name.
+	 *
+	 * \param name   The field name.
+	 * \param value  The field value.
+	 *
+	 * \note  name and value must either lie within the base string
+	 *        or reference static storage.
+	 */
+	void Add(const StringView &name, const StringView &value);
+
+	/**
+	 * Reference a new base string.  The new string must hold
+	 * the same content as the current base string, typically
+	 * because it is a copy of it.
+	 */
+	void Rebase(const StringView &base);
+
+	/**
+	 * \return  True if all fields of the base string have been added.
+	 */
+	bool FullyParsed()					const;
+
+	/**
+	 * \return  The offset into the base string at which parsing
+	 *          was deferred.  Only valid if FullyParsed() is false.
+	 */
+	size_t UnparsedOffset()					const;
+
+	/**
+	 * Record the offset into the base string at which parsing was
+	 * deferred, or StringView::npos once all fields have been added.
+	 */
+	void SetUnparsedOffset(size_t offset);
+
+	/**
+	 * \return  True if all header keys are present.
+	 */
+	bool HaveHeader()					const;
+
+	/**
+	 * \return  An iterator to the field with the given name, or end()
+	 *          if no such field exists.
+	 */
+	const_iterator find(const StringView &name)		const;
+
+	/**
+	 * \return  The EventKey for the given field name, or
+	 *          NUM_EVENT_KEYS if the name is not well known.
+	 */
+	static EventKey LookupKey(const StringView &name);
+
+	/**
+	 * Determine the availability of a well known field.
+	 *
+	 * \param key  The field to test for.
+	 *
+	 * \return  true if the field is present, otherwise false.
+	 */
+	bool	       Contains(EventKey key)			const;
+
+	/**
+	 * \param key  The well known field for which to retrieve
+	 *             its value.
+	 *
+	 * \return  The value of the field, or an empty view if the field
+	 *          is not present.
+	 */
+	StringView     Value(EventKey key)			const;
+
+	const_iterator begin()					const;
+	const_iterator end()					const;
+	size_t	       size()					const;
+	bool	       empty()					const;
+
+private:
+	/**
+	 * Location of a name or value.  m_static is NULL for ranges
+	 * within the base string, and otherwise holds the address
+	 * of the static storage referenced.
+	 */
+	struct Range
+	{
+		const char *m_static;
+		size_t	    m_offset;
+		size_t	    m_length;
+	};
+
+	/** Location of a single field. */
+	struct Field
+	{
+		Range m_name;
+		Range m_value;
+	};
+
+	enum {
+		/*
+		 * The number of fields for which space is allocated
+		 * when the first field is added.  Most events fit
+		 * without the field list being reallocated.
+		 */
+		INITIAL_FIELDS = 16
+	};
+
+	/* Maps are copied with the copy constructor only. */
+	NVPairMap &operator=(const NVPairMap &);
+
+	/** Enlarge the field list to hold at least one more field. */
+	void	   Grow();
+
+	/** Convert a view into a Range relative to m_base. */
+	Range	   ToRange(const StringView &view)		const;
+
+	/** Convert a Range into a view. */
+	StringView ToView(const Range &range)			const;
+
+	/**
+	 * \return  The index of the first field whose name is not
+	 *          less than name.
+	 */
+	size_t LowerBound(const StringView &name)		const;
+
+	/** Table entries used to map an EventKey to its field name. */
+	struct KeyRecord
+	{
+		const char *m_name;
+		size_t	    m_length;
+	};
+
+	/** Field names indexed by EventKey. */
+	static const KeyRecord s_keyTable[];
+
+	/** The string referenced by all fields. */
+	StringView	m_base;
+
+	/** Fields sorted by name. */
+	Field	       *m_fields;
+
+	/** The number of fields in m_fields. */
+	size_t		m_numFields;
+
+	/** The number of fields for which m_fields has space. */
+	size_t		m_maxFields;
+
+	/** The source of m_fields, or NULL for the heap. */
+	EventArena     *m_arena;
+
+	/** See SetPendingOwner(). */
+	NVPairMap     **m_pendingOwner;
+
+	/** Values of the well known fields, indexed by EventKey. */
+	Range		m_keyValues[NUM_EVENT_KEYS];
+
+	/** Bitmask, indexed by EventKey, of the well known fields present. */
+	unsigned int	m_keysPresent;
+
+	/**
+	 * Offset into m_base at which parsing was deferred, or
+	 * StringView::npos if m_base has been fully parsed.
+	 */
+	size_t		m_unparsedOffset;
+};
+
+//- NVPairMap Inline Public Methods --------------------------------------------
+inline NVPairMap::const_iterator
+NVPairMap::begin() const
+{
+	return (const_iterator(this, 0));
+}
+
+inline NVPairMap::const_iterator
+NVPairMap::end() const
+{
+	return (const_iterator(this, m_numFields));
+}
+
+inline size_t
+NVPairMap::size() const
+{
+	return (m_numFields);
+}
+
+inline bool
+NVPairMap::empty() const
+{
+	return (m_numFields == 0);
+}
+
+inline void
+NVPairMap::Rebase(const StringView &base)
+{
+	m_base = base;
+}
+
+inline bool
+NVPairMap::FullyParsed() const
+{
+	return (m_unparsedOffset == StringView::npos);
+}
+
+inline size_t
+NVPairMap::UnparsedOffset() const
+{
+	return (m_unparsedOffset);
+}
+
+inline void
+NVPairMap::SetUnparsedOffset(size_t offset)
+{
+	m_unparsedOffset = offset;
+}
+
+inline bool
+NVPairMap::HaveHeader() const
+{
+	const unsigned int headerMask((1U << (KEY_LAST_HEADER + 1)) - 1);
+
+	return ((m_keysPresent & headerMask) == headerMask);
+}
+
+inline bool
+NVPairMap::Contains(EventKey key) const
+{
+	return ((m_keysPresent & (1U << key)) != 0);
+}
+
+inline StringView
+NVPairMap::Value(EventKey key) const
+{
+	if (!Contains(key))
+		return (StringView());
+	return (ToView(m_keyValues[key]));
+}
+
+//- NVPairMap Inline Private Methods -------------------------------------------
+inline StringView
+NVPairMap::ToView(const Range &range) const
+{
+	if (range.m_static != NULL)
+		return (StringView(range.m_static, range.m_length));
+	return (StringView(m_base.data() + range.m_offset, range.m_length));
+}
+
+//- NVPairMap::const_iterator Inline Public Methods ----------------------------
+inline
+NVPairMap::const_iterator::const_iterator()
+ : m_map(NULL),
+   m_index(0)
+{
+}
+
+inline
+NVPairMap::const_iterator::const_iterator(const NVPairMap *map, size_t index)
+ : m_map(map),
+   m_index(index)
+{
+}
+
+inline const NVPairMap::value_type &
+NVPairMap::const_iterator::operator*() const
+{
+	const Field &field(m_map->m_fields[m_index]);
+
+	m_value.first  = m_map->ToView(field.m_name);
+	m_value.second = m_map->ToView(field.m_value);
+	return (m_value);
+}
+
+inline const NVPairMap::value_type *
+NVPairMap::const_iterator::operator->() const
+{
+	return (&**this);
+}
+
+inline NVPairMap::const_iterator &
+NVPairMap::const_iterator::operator++()
+{
+	m_index++;
+	return (*this);
+}
+
+inline NVPairMap::const_iterator
+NVPairMap::const_iterator::operator++(int)
+{
+	const_iterator prev(*this);
+
+	m_index++;
+	return (prev);
+}
+
+inline bool
+NVPairMap::const_iterator::operator==(const const_iterator &rhs) const
+{
+	return (m_map == rhs.m_map && m_index == rhs.m_index);
+}
+
+inline bool
+NVPairMap::const_iterator::operator!=(const const_iterator &rhs) const
+{
+	return (!(*this == rhs));
+}
 
 /*----------------------------------- Event ----------------------------------*/
 /**
@@ -65,13 +485,22 @@ typedef std::map<std::string, std::string> NVPairMap;
  * and Value() methods.  name => value pairs for data not explicitly
  * received as a name => value pair are synthesized during parsing.  For
  * example, ATTACH and DETACH events have "device-name" and "parent"
- * name => value pairs added.
+ * name => value pairs added.  Names and values reference the event
+ * string and are only valid for the lifetime of the event.
  */
 class Event
 {
 	friend class EventFactory;
 
 public:
+	enum {
+		/**
+		 * The size of the buffer into which Log() formats an
+		 * event.  syslog(3) truncates longer messages regardless.
+		 */
+		LOG_BUFFER_SIZE = 2048
+	};
+
 	/** Event type */
 	enum Type {
 		/** Generic event notification. */
@@ -87,19 +516,142 @@ public:
 		DETACH  = '-'
 	};
 
+	/**
+	 * Outcome of checking whether an event string can be parsed.
+	 * Routine rejections are reported by status rather than by
+	 * exception.  Only malformed event data raises ParseException.
+	 */
+	enum ParseStatus {
+		/** The event is of a type that is parsed. */
+		PARSE_OK,
+
+		/** The event is of a type that is never built (NOMATCH). */
+		PARSE_DISCARDED,
+
+		/** The event type is not recognized. */
+		PARSE_UNKNOWN_TYPE
+	};
+
 	/**
 	 * Factory method type to construct an Event given
 	 * the type of event and an NVPairMap populated from
 	 * the event string received from devd.
 	 */
-	typedef Event* (BuildMethod)(Type, NVPairMap &, const std::string &);
+	typedef Event* (BuildMethod)(Type, NVPairMap &, const StringView &);
 
 	/** Generic Event object factory. */
 	static BuildMethod Builder;
 
+	/**
+	 * Create an Event holding its own copy of the event data.
+	 *
+	 * \param factory      The factory used to select the Event type.
+	 * \param eventString  The devd event string to parse.
+	 *
+	 * \return  The new event, or NULL if the event is discarded.
+	 */
 	static Event *CreateEvent(const EventFactory &factory,
 				  const std::string &eventString);
 
+	/**
+	 * Create an Event that references, but does not copy, the
+	 * supplied event data.  The returned event must not outlive the
+	 * storage backing eventString.  Events that must be kept beyond
+	 * that point are kept via Retain(), which gives the retained
+	 * copy its own storage.
+	 *
+	 * When lazy is true, only the header fields used to route the
+	 * event (see EventKey) are parsed up front.  The remaining fields
+	 * are parsed on first access via Value(), Contains(), GetMap()
+	 * or ToString().  Errors found in the deferred fields are logged
+	 * and the fields parsed up to that point are retained, rather
+	 * than the event being discarded.
+	 *
+	 * When an arena is supplied, the event and its field map are
+	 * allocated from it.  The event must then also not outlive
+	 * the arena.
+	 *
+	 * \param factory      The factory used to select the Event type.
+	 * \param eventString  The devd event data to parse.
+	 * \param lazy         Defer parsing of non-header fields.
+	 * \param arena        The arena to allocate from, or NULL to
+	 *                     allocate from the heap.
+	 * \param clock        The clock for the batch in which the event
+	 *                     was received, or NULL.  It supplies the
+	 *                     event's receive time (see GetAge()), and
+	 *                     its timestamp if the event data has none.
+	 *
+	 * \return  The new event, or NULL if the event is discarded.
+	 */
+	static Event *CreateEventView(const EventFactory &factory,
+				      const StringView &eventString,
+				      bool lazy = false,
+				      EventArena *arena = NULL,
+				      EventClock *clock = NULL);
+
+	/** Allocate an event from the heap. */
+	static void *operator new(size_t size);
+
+	/**
+	 * Allocate an event from an arena.  Build methods allocate
+	 * the events they construct with
+	 * new (nvpairs.GetArena()), so that events built by
+	 * CreateEventView() share the arena of their data.
+	 *
+	 * \param size   The size of the event.
+	 * \param arena  The arena to allocate from, or NULL for the heap.
+	 */
+	static void *operator new(size_t size, EventArena *arena);
+
+	static void operator delete(void *addr);
+	static void operator delete(void *addr, EventArena *arena);
+
+	/**
+	 * \return  The number of lazily parsed events that were destroyed,
+	 *          or discarded by their factory, without their deferred
+	 *          fields ever being parsed.
+	 */
+	static uint64_t UnparsedEventCount();
+
+	/**
+	 * Determine whether events of the given type are parsed.
+	 *
+	 * \param type  The type of an event, from the first character
+	 *              of its event string.
+	 *
+	 * \return  PARSE_OK, or the reason events of this type are
+	 *          discarded.
+	 */
+	static ParseStatus CheckType(Type type);
+
+	/**
+	 * Find the value of a field of an event string without parsing it.
+	 *
+	 * \param eventString  The devd event data, or the unparsed
+	 *                     remainder of it, to examine.
+	 * \param name         The name of the field to find.
+	 * \param value        Returns the value of the field, if found.
+	 *                     If the field occurs more than once, its
+	 *                     last value is returned, as it would be
+	 *                     once the event is parsed.
+	 *
+	 * \return  True if the field was found.  Otherwise false.
+	 */
+	static bool PeekField(const StringView &eventString,
+			      const StringView &name, StringView &value);
+
+	/**
+	 * Find the value of the "system" field of an event string
+	 * without parsing it.
+	 *
+	 * \param eventString  The devd event data to examine.
+	 *
+	 * \return  The value of the "system" field or, if there is none,
+	 *          "none":  the system name with which build methods for
+	 *          such events are registered.
+	 */
+	static StringView PeekSystem(const StringView &eventString);
+
 	/**
 	 * Provide a user friendly string representation of an
 	 * event type.
@@ -118,19 +670,41 @@ public:
 	 * \return  true if the specified key is available in this
 	 *          event, otherwise false.
 	 */
-	bool Contains(const std::string &name)		 const;
+	bool Contains(const StringView &name)		 const;
+
+	/**
+	 * Determine the availability of a well known name => value pair.
+	 *
+	 * \param key  The field to search for in this event instance.
+	 *
+	 * \return  true if the specified field is available in this
+	 *          event, otherwise false.
+	 */
+	bool Contains(EventKey key)			 const;
 
 	/**
 	 * \param key  The name of the key for which to retrieve its
 	 *             associated value.
 	 *
-	 * \return  A const reference to the string representing the
-	 *          value associated with key.
+	 * \return  A view of the value associated with key.  The view
+	 *          is valid for the lifetime of this event.
 	 *
-	 * \note  For key's with no registered value, the empty string
+	 * \note  For key's with no registered value, an empty view
 	 *        is returned.
 	 */
-	const std::string &Value(const std::string &key) const;
+	StringView Value(const StringView &key)		 const;
+
+	/**
+	 * Retrieve the value of a well known field without searching
+	 * for it by name.
+	 *
+	 * \param key  The field for which to retrieve its value.
+	 *
+	 * \return  A view of the value of the field, or an empty view
+	 *          if the field is not present.  The view is valid for
+	 *          the lifetime of this event.
+	 */
+	StringView Value(EventKey key)			 const;
 
 	/**
 	 * Get the type of this event instance.
@@ -142,9 +716,10 @@ public:
 	/**
 	 * Get the orginal DevCtl event string for this event.
 	 *
-	 * \return  The DevCtl event string.
+	 * \return  The DevCtl event string.  The view is valid for the
+	 *          lifetime of this event.
 	 */
-	const std::string &GetEventString()		 const;
+	const StringView &GetEventString()		 const;
 
 	/**
 	 * Convert the event instance into a string suitable for
@@ -154,6 +729,21 @@ public:
 	 */
 	std::string ToString()				 const;
 
+	/**
+	 * Format the event, as for ToString(), into a caller supplied
+	 * buffer without allocating memory.
+	 *
+	 * \param buf   The buffer to format into.  Unless size is 0,
+	 *              the result is always NUL terminated, and is
+	 *              truncated if the buffer is too small.
+	 * \param size  The size of buf.
+	 *
+	 * \return  The length of the complete formatted event, excluding
+	 *          its NUL terminator.  As with snprintf(3), a value of
+	 *          size or more indicates that the output was truncated.
+	 */
+	size_t Format(char *buf, size_t size)		 const;
+
 	/**
 	 * Pretty-print this event instance to cout.
 	 */
@@ -173,7 +763,31 @@ public:
 	 */
 	virtual Event *DeepCopy()			 const;
 
-	/** Destructor */
+	/**
+	 * Obtain a reference to this event that remains valid after
+	 * the data viewed by this event is reused.  An event that
+	 * owns its event string is shared, at the cost of a reference
+	 * count increment.  A view is copied on its first Retain(),
+	 * and later calls share that copy.
+	 *
+	 * \return  A handle referencing the retained event.
+	 */
+	EventHandle Retain()				 const;
+
+	/** Add a reference to this event. */
+	void Hold()					 const;
+
+	/**
+	 * Drop a reference to this event, destroying it once no
+	 * references remain.
+	 */
+	void Release()					 const;
+
+	/**
+	 * Destructor.  Events are created holding a single reference
+	 * on behalf of their creator, who may delete an event that has
+	 * not been shared.  Shared events must be released instead.
+	 */
 	virtual ~Event();
 
 	/**
@@ -185,22 +799,61 @@ public:
 	virtual bool Process()				 const;
 
 	/**
-	 * Get the time that the event was created
+	 * Get the time that the event was created.  The "timestamp"
+	 * field is converted once, when the event is constructed or,
+	 * for events whose field parsing was deferred, on first access.
+	 * Fractional seconds (e.g. "timestamp=1348871594.25") are
+	 * retained with nanosecond resolution.  Received events without
+	 * a "timestamp" field are stamped with the time they were
+	 * received.
+	 *
+	 * \throws Exception if the event has no timestamp.
+	 */
+	const timespec &GetTimestamp()			 const;
+
+	/**
+	 * \return  True if the event was received by a Consumer and so
+	 *          has a monotonic receive time.
+	 */
+	bool HasReceiveTime()				 const;
+
+	/**
+	 * \return  The CLOCK_MONOTONIC time at which the event was
+	 *          received.  Only valid if HasReceiveTime() is true.
+	 */
+	const timespec &GetReceiveTime()		 const;
+
+	/**
+	 * Get the time elapsed since the event occurred.  For received
+	 * events this is measured against the monotonic receive time,
+	 * and so is unaffected by steps of the wall clock.  For all other
+	 * events (e.g. those restored from saved state), it is the
+	 * difference between the wall clock and the event's timestamp.
+	 * The result is never negative.
+	 *
+	 * \throws Exception if the event has neither a receive time
+	 *         nor a timestamp.
+	 */
+	timespec GetAge()				 const;
+
+	/**
+	 * Set the time that the event was created, overriding any
+	 * "timestamp" field in the event data.  Used to restore the
+	 * timestamps of saved events.  The event must not yet be shared.
 	 */
-	timeval GetTimestamp()				 const;
+	void SetTimestamp(const timespec &timestamp);
 
 	/**
-	 * Add a timestamp to the event string, if one does not already exist
-	 * TODO: make this an instance method that operates on the std::map
-	 * instead of the string.  We must fix zfsd's CaseFile serialization
-	 * routines first, so that they don't need the raw event string.
+	 * Convert the value of a "timestamp" field:  seconds since the
+	 * Epoch, optionally followed by a fraction of a second.
 	 *
-	 * \param[in,out] eventString The devd event string to modify
+	 * \return  The timestamp, or a timespec of all zeros if value
+	 *          is not a usable timestamp.
 	 */
-	static void TimestampEventString(std::string &eventString);
+	static timespec ParseTimestamp(const StringView &value);
 
 	/**
-	 * Access all parsed key => value pairs.
+	 * Access all key => value pairs, parsing any deferred fields.
 	 */
 	const NVPairMap &GetMap()			 const;
 
@@ -217,17 +870,23 @@ protected:
 	 *
 	 * \param type  The type of event to create.
 	 */
-	Event(Type type, NVPairMap &map, const std::string &eventString);
+	Event(Type type, NVPairMap &map, const StringView &eventString);
 
 	/** Deep copy constructor. */
 	Event(const Event &src);
 
-	/** Always empty string returned when NVPairMap lookups fail. */
-	static const std::string    s_theEmptyString;
+	/**
+	 * Parse any fields whose parsing was deferred when this
+	 * event was created.
+	 */
+	void ParseDeferredFields()			 const;
 
 	/** Unsorted table of event types. */
 	static EventTypeRecord      s_typeTable[];
 
+	/** See UnparsedEventCount(). */
+	static uint64_t             s_unparsedEventCount;
+
 	/** The type of this event. */
 	const Type                  m_type;
 
@@ -237,25 +896,87 @@ protected:
 	 * \note Although stored by reference (since m_nvPairs can
 	 *       never be NULL), the NVPairMap referenced by this field
 	 *       is dynamically allocated and owned by this event object.
-	 *       m_nvPairs must be deleted at event desctruction.
+	 *       m_nvPairs must be deleted at event desctruction.  Its
+	 *       fields reference m_eventString.
 	 */
 	NVPairMap                  &m_nvPairs;
 
+	/**
+	 * Storage for the event string of events that own their
+	 * event data.  Empty for events created by CreateEventView().
+	 */
+	std::string                 m_eventStorage;
+
 	/**
 	 * The unaltered event string, as received from devd, used to
-	 * create this event object.
+	 * create this event object.  References either m_eventStorage
+	 * or data owned by the creator of this event.
+	 */
+	StringView                  m_eventString;
+
+	/**
+	 * The event's timestamp.  Valid once m_haveTimestamp is set.
+	 * Until then, for received events, the wall clock time at which
+	 * the event was received:  the timestamp used if the event data
+	 * has no "timestamp" field.
 	 */
-	std::string                 m_eventString;
+	mutable timespec            m_timestamp;
+	mutable bool                m_haveTimestamp;
+
+	/**
+	 * The CLOCK_MONOTONIC time at which this event was received.
+	 * Valid if m_haveReceiveTime is set.
+	 */
+	timespec                    m_receiveTime;
+	bool                        m_haveReceiveTime;
+
+	/** The number of references held on this event. */
+	mutable unsigned int        m_refCount;
+
+	/**
+	 * For views, the copy created by the first call to Retain().
+	 * This event holds a reference on the copy.
+	 */
+	mutable const Event        *m_retainedCopy;
 
 private:
 	/**
-	 * Ingest event data from the supplied string.
+	 * Copy the event string into m_eventStorage so that this
+	 * event no longer references its creator's data.
+	 */
+	void RetainEventString();
+
+	/** Parse the fields deferred by a lazy parse. */
+	void ParseRemainingFields()			 const;
+
+	/**
+	 * Ingest event data from the supplied string.  Throws
+	 * ParseException if the data is malformed.
+	 *
+	 * \param[in] type         The event type, which must have been
+	 *                         accepted by CheckType().
+	 * \param[in] eventString  The string of devd event data to parse.
+	 * \param[out] nvpairs     Returns the parsed data
+	 * \param[in] headerOnly   Stop once the header fields of a NOTIFY
+	 *                         event have been parsed, recording where
+	 *                         parsing stopped in nvpairs.
+	 */
+	static void ParseEventString(Type type, const StringView &eventString,
+				     NVPairMap &nvpairs,
+				     bool headerOnly = false);
+
+	/**
+	 * Parse the name=value pairs of an event string.
 	 *
 	 * \param[in] eventString  The string of devd event data to parse.
+	 * \param[in] start        The offset at which to start parsing.
 	 * \param[out] nvpairs     Returns the parsed data
+	 * \param[in] headerOnly   Stop once the header fields have been
+	 *                         parsed.
 	 */
-	static void ParseEventString(Type type, const std::string &eventString,
-				     NVPairMap &nvpairs);
+	static void ParseFields(Type type, const StringView &eventString,
+				size_t start, NVPairMap &nvpairs,
+				bool headerOnly);
 };
 
 inline Event::Type
@@ -264,7 +985,7 @@ Event::GetType() const
 	return (m_type);
 }
 
-inline const std::string &
+inline const StringView &
 Event::GetEventString() const
 {
 	return (m_eventString);
@@ -273,14 +994,164 @@ Event::GetEventString() const
 inline const NVPairMap &
 Event::GetMap()	const
 {
+	ParseDeferredFields();
 	return (m_nvPairs);
 }
 
+inline bool
+Event::Contains(EventKey key) const
+{
+	if (key > KEY_LAST_HEADER)
+		ParseDeferredFields();
+	return (m_nvPairs.Contains(key));
+}
+
+inline StringView
+Event::Value(EventKey key) const
+{
+	if (key > KEY_LAST_HEADER)
+		ParseDeferredFields();
+	return (m_nvPairs.Value(key));
+}
+
+inline bool
+Event::HasReceiveTime() const
+{
+	return (m_haveReceiveTime);
+}
+
+inline const timespec &
+Event::GetReceiveTime() const
+{
+	return (m_receiveTime);
+}
+
+inline uint64_t
+Event::UnparsedEventCount()
+{
+	return (s_unparsedEventCount);
+}
+
+inline void
+Event::ParseDeferredFields() const
+{
+	if (!m_nvPairs.FullyParsed())
+		ParseRemainingFields();
+}
+
+inline void
+Event::Hold() const
+{
+	m_refCount++;
+}
+
+inline void
+Event::Release() const
+{
+	if (--m_refCount == 0)
+		delete this;
+}
+
+/*-------------------------------- EventHandle -------------------------------*/
+/**
+ * \brief A counted reference to an immutable Event.
+ *
+ * Copying a handle adds a reference to its event, and destroying
+ * it drops one.  Events are not thread safe, and neither is their
+ * reference count.
+ */
+class EventHandle
+{
+public:
+	/** Construct a handle that references no event. */
+	EventHandle();
+
+	/**
+	 * Construct a handle that takes over a reference to event
+	 * already held by the caller, such as the reference returned
+	 * with a newly created event.
+	 */
+	explicit EventHandle(const Event *event);
+
+	EventHandle(const EventHandle &src);
+	~EventHandle();
+
+	EventHandle &operator=(const EventHandle &rhs);
+
+	const Event &operator*()			 const;
+	const Event *operator->()			 const;
+
+	/** \return  The referenced event, or NULL. */
+	const Event *Get()				 const;
+
+private:
+	const Event *m_event;
+};
+
+//- EventHandle Inline Public Methods ------------------------------------------
+inline
+EventHandle::EventHandle()
+ : m_event(NULL)
+{
+}
+
+inline
+EventHandle::EventHandle(const Event *event)
+ : m_event(event)
+{
+}
+
+inline
+EventHandle::EventHandle(const EventHandle &src)
+ : m_event(src.m_event)
+{
+	if (m_event != NULL)
+		m_event->Hold();
+}
+
+inline
+EventHandle::~EventHandle()
+{
+	if (m_event != NULL)
+		m_event->Release();
+}
+
+inline EventHandle &
+EventHandle::operator=(const EventHandle &rhs)
+{
+	/* Hold first, in case rhs references the same event. */
+	if (rhs.m_event != NULL)
+		rhs.m_event->Hold();
+	if (m_event != NULL)
+		m_event->Release();
+	m_event = rhs.m_event;
+	return (*this);
+}
+
+inline const Event &
+EventHandle::operator*() const
+{
+	return (*m_event);
+}
+
+inline const Event *
+EventHandle::operator->() const
+{
+	return (m_event);
+}
+
+inline const Event *
+EventHandle::Get() const
+{
+	return (m_event);
+}
+
 /*--------------------------------- EventList --------------------------------*/
 /**
  * EventList is a specialization of the standard list STL container.
+ * Its handles keep the listed events alive.
  */
-typedef std::list<Event *> EventList;
+typedef std::list<EventHandle> EventList;
 
 /*-------------------------------- DevfsEvent --------------------------------*/
 class DevfsEvent : public Event
@@ -328,39 +1199,116 @@ protected:
 	DevfsEvent(const DevfsEvent &src);
 
 	/** Constructor */
-	DevfsEvent(Type, NVPairMap &, const std::string &);
+	DevfsEvent(Type, NVPairMap &, const StringView &);
 };
 
 /*--------------------------------- ZfsEvent ---------------------------------*/
 class ZfsEvent : public Event
 {
 public:
+	/**
+	 * Classification of ZFS events by their "type", or failing
+	 * that their "class", field.  Computed once when the event
+	 * is built so that handlers need not compare strings.
+	 */
+	enum Kind
+	{
+		/** An event type or class not listed below. */
+		UNKNOWN_KIND,
+
+		/* misc.fs.zfs.* pool configuration events. */
+		CONFIG_SYNC,
+		POOL_DESTROY,
+		RESILVER_FINISH,
+		VDEV_REMOVE,
+
+		/** Any other misc.fs.zfs.* event. */
+		OTHER_POOL_EVENT,
+
+		/* resource.fs.zfs.* events. */
+		VDEV_REMOVED,
+		VDEV_STATECHANGE,
+
+		/* ereport.fs.zfs.* events. */
+		IO_EREPORT,
+		CHECKSUM_EREPORT,
+		NO_REPLICAS_EREPORT
+	};
+
 	/** Specialized Event object factory for ZFS events. */
 	static BuildMethod Builder;
 
+	/**
+	 * Classify a ZFS event type or class name.
+	 *
+	 * \param name  The value of an event's "type" or "class" field.
+	 *
+	 * \return  The Kind of event named, or UNKNOWN_KIND.
+	 */
+	static Kind Classify(const StringView &name);
+
 	virtual Event *DeepCopy()	const;
 
-	const std::string &PoolName()	const;
+	Kind		   GetKind()	const;
+	bool		   IsPoolEvent() const;
+	StringView	   PoolName()	const;
 	Guid		   PoolGUID()	const;
 	Guid		   VdevGUID()	const;
 
 protected:
 	/** Constructor */
-	ZfsEvent(Type, NVPairMap &, const std::string &);
+	ZfsEvent(Type, NVPairMap &, const StringView &);
 
 	/** Deep copy constructor. */
 	ZfsEvent(const ZfsEvent &src);
 
+	/** Perfect hash table entries used to classify events. */
+	struct KindRecord
+	{
+		const char *m_name;
+		size_t	    m_length;
+		Kind	    m_kind;
+	};
+
+	/**
+	 * Size of s_kindTable.  Must be a power of two, and large
+	 * enough that no two entries of the table share a slot.
+	 */
+	enum { KIND_TABLE_SIZE = 16 };
+
+	/**
+	 * Slot of s_kindTable which would hold the given name.
+	 *
+	 * \param name  A non-empty event type or class name.
+	 */
+	static size_t KindHash(const StringView &name);
+
+	/** Table of event kinds, indexed by KindHash(). */
+	static const KindRecord s_kindTable[KIND_TABLE_SIZE];
+
+	Kind	m_kind;
 	Guid	m_poolGUID;
 	Guid	m_vdevGUID;
 };
 
 //- ZfsEvent Inline Public Methods --------------------------------------------
-inline const std::string&
+inline ZfsEvent::Kind
+ZfsEvent::GetKind() const
+{
+	return (m_kind);
+}
+
+inline bool
+ZfsEvent::IsPoolEvent() const
+{
+	return (m_kind >= CONFIG_SYNC && m_kind <= OTHER_POOL_EVENT);
+}
+
+inline StringView
 ZfsEvent::PoolName() const
 {
 	/* The pool name is reported as the subsystem of ZFS events. */
-	return (Value("subsystem"));
+	return (Value(KEY_SUBSYSTEM));
 }
 
 inline Guid
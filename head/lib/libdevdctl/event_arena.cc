@@ -0,0 +1,178 @@
+/*-
+ * Copyright (c) 2012, 2013 Spectra Logic Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions, and the following disclaimer,
+ *    without modification.
+ * 2. Redistributions in binary form must reproduce at minimum a disclaimer
+ *    substantially similar to the "NO WARRANTY" disclaimer below
+ *    ("Disclaimer") and any redistribution must be conditioned upon
+ *    including a substantially similar Disclaimer requirement for further
+ *    binary redistribution.
+ *
+ * NO WARRANTY
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTIBILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDERS OR CONTRIBUTORS BE LIABLE FOR SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGES.
+ *
+ * $FreeBSD$
+ */
+
+/**
+ * \file event_arena.cc
+ *
+ * Implementation of the EventArena class.
+ */
+#include <sys/cdefs.h>
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#include <algorithm>
+#include <new>
+
+#include "event_arena.h"
+
+__FBSDID("$FreeBSD$");
+/*============================ Namespace Control =============================*/
+namespace DevCtl
+{
+
+/*=========================== Class Implementations ==========================*/
+/*-------------------------------- EventArena --------------------------------*/
+//- EventArena Static Private Data ---------------------------------------------
+uint64_t EventArena::s_heapAllocations;
+
+//- EventArena Static Public Methods -------------------------------------------
+void *
+EventArena::Allocate(EventArena *arena, size_t size)
+{
+	Header *header;
+
+	if (arena != NULL) {
+		header = arena->Carve(size);
+		arena->m_live++;
+		arena->m_allocations++;
+	} else {
+		header = static_cast<Header *>(malloc(sizeof(Header) + size));
+		if (header == NULL)
+			throw std::bad_alloc();
+		s_heapAllocations++;
+	}
+	header->m_arena = arena;
+	return (header + 1);
+}
+
+void
+EventArena::Free(void *addr)
+{
+	if (addr == NULL)
+		return;
+
+	Header *header(static_cast<Header *>(addr) - 1);
+
+	if (header->m_arena != NULL)
+		header->m_arena->Release();
+	else
+		free(header);
+}
+
+//- EventArena Public Methods --------------------------------------------------
+EventArena::EventArena(size_t chunkSize)
+ : m_chunkSize(Align(chunkSize)),
+   m_chunks(NULL),
+   m_lastChunk(NULL),
+   m_current(NULL),
+   m_offset(0),
+   m_live(0),
+   m_allocations(0),
+   m_chunkAllocations(0)
+{
+}
+
+EventArena::~EventArena()
+{
+	while (m_chunks != NULL) {
+		Chunk *next(m_chunks->m_next);
+
+		free(m_chunks);
+		m_chunks = next;
+	}
+}
+
+//- EventArena Static Private Methods ------------------------------------------
+char *
+EventArena::ChunkData(Chunk *chunk)
+{
+	return (reinterpret_cast<char *>(chunk) + Align(sizeof(Chunk)));
+}
+
+size_t
+EventArena::Align(size_t size)
+{
+	return ((size + sizeof(Header) - 1) / sizeof(Header) * sizeof(Header));
+}
+
+//- EventArena Private Methods -------------------------------------------------
+EventArena::Header *
+EventArena::Carve(size_t size)
+{
+	size_t needed(sizeof(Header) + Align(size));
+
+	/*
+	 * Chunks are used in order.  Space left at the end of a
+	 * chunk that is too small is reclaimed by the next rewind.
+	 */
+	while (m_current != NULL && m_offset + needed > m_current->m_size) {
+		m_current = m_current->m_next;
+		m_offset = 0;
+	}
+
+	if (m_current == NULL) {
+		size_t chunkSize(std::max(m_chunkSize, needed));
+		Chunk *chunk(static_cast<Chunk *>(
+		    malloc(Align(sizeof(Chunk)) + chunkSize)));
+
+		if (chunk == NULL)
+			throw std::bad_alloc();
+		m_chunkAllocations++;
+		chunk->m_next = NULL;
+		chunk->m_size = chunkSize;
+		if (m_lastChunk != NULL)
+			m_lastChunk->m_next = chunk;
+		else
+			m_chunks = chunk;
+		m_lastChunk = chunk;
+		m_current   = chunk;
+		m_offset    = 0;
+	}
+
+	Header *header(reinterpret_cast<Header *>(ChunkData(m_current)
+						  + m_offset));
+	m_offset += needed;
+	return (header);
+}
+
+void
+EventArena::Release()
+{
+	/* Once nothing references the arena, rewind it. */
+	if (--m_live == 0) {
+		m_current = m_chunks;
+		m_offset  = 0;
+	}
+}
+
+} // namespace DevCtl
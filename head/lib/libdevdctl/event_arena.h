@@ -0,0 +1,220 @@
+/*-
+ * Copyright (c) 2012, 2013 Spectra Logic Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions, and the following disclaimer,
+ *    without modification.
+ * 2. Redistributions in binary form must reproduce at minimum a disclaimer
+ *    substantially similar to the "NO WARRANTY" disclaimer below
+ *    ("Disclaimer") and any redistribution must be conditioned upon
+ *    including a substantially similar Disclaimer requirement for further
+ *    binary redistribution.
+ *
+ * NO WARRANTY
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTIBILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDERS OR CONTRIBUTORS BE LIABLE FOR SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGES.
+ *
+ * $FreeBSD$
+ */
+
+/**
+ * \file devctl_event_arena.h
+ *
+ * Definition of the EventArena class.
+ *
+ * Header requirements:
+ *
+ *    #include <stdint.h>
+ */
+#ifndef	_DEVCTL_EVENT_ARENA_H_
+#define	_DEVCTL_EVENT_ARENA_H_
+
+/*============================ Namespace Control =============================*/
+namespace DevCtl
+{
+
+/*============================= Class Definitions ============================*/
+/*-------------------------------- EventArena --------------------------------*/
+/**
+ * \brief Short lived storage for events and their field maps.
+ *
+ * Events received from devd are typically examined and then destroyed
+ * within a single pass of the event loop.  An EventArena serves the
+ * allocations made while such events are built from chunks of memory
+ * that it retains, so that once the chunks have grown to fit a batch of
+ * events, building further batches calls malloc(3) not at all.
+ *
+ * Individual allocations are never reused.  Instead, the arena is
+ * rewound in bulk once every allocation made from it has been freed,
+ * which happens naturally when the last event of a batch is destroyed.
+ * Events that must outlive their batch are copied to the heap by
+ * Event::Retain().
+ *
+ * Allocate() and Free() also serve heap allocations, when passed a
+ * NULL arena, so that the owner of a block need not track where it
+ * came from.
+ */
+class EventArena
+{
+public:
+	enum {
+		/** Size of the chunks from which allocations are made. */
+		DEFAULT_CHUNK_SIZE = 16 * 1024
+	};
+
+	/**
+	 * Constructor
+	 *
+	 * \param chunkSize  Size of the chunks from which allocations
+	 *                   are made.  Larger requests receive a chunk
+	 *                   of their own.
+	 */
+	EventArena(size_t chunkSize = DEFAULT_CHUNK_SIZE);
+
+	/**
+	 * Destructor.  All allocations from the arena must have been
+	 * freed.
+	 */
+	~EventArena();
+
+	/**
+	 * Allocate memory suitably aligned for any object.
+	 *
+	 * \param arena  The arena to allocate from, or NULL to allocate
+	 *               from the heap.
+	 * \param size   The number of bytes required.
+	 *
+	 * \return  The allocated memory.  Throws std::bad_alloc on failure.
+	 */
+	static void *Allocate(EventArena *arena, size_t size);
+
+	/**
+	 * Free memory obtained from Allocate().
+	 *
+	 * \param addr  The memory to free, or NULL.
+	 */
+	static void Free(void *addr);
+
+	/**
+	 * \return  The number of blocks Allocate() has obtained from
+	 *          the heap, across all callers.
+	 */
+	static uint64_t HeapAllocations();
+
+	/** \return  The number of allocations served by this arena. */
+	uint64_t Allocations()				const;
+
+	/**
+	 * \return  The number of chunks this arena has obtained from
+	 *          the heap.
+	 */
+	uint64_t ChunkAllocations()			const;
+
+	/** \return  The number of allocations not yet freed. */
+	size_t   LiveAllocations()			const;
+
+private:
+	/** A block of memory from which allocations are carved. */
+	struct Chunk
+	{
+		Chunk  *m_next;
+		size_t	m_size;
+	};
+
+	/**
+	 * Prefix of every allocation, recording its source.  The
+	 * union pads the prefix so that it preserves the alignment
+	 * of the memory that follows it.
+	 */
+	union Header
+	{
+		EventArena *m_arena;
+		long double m_alignLongDouble;
+		uint64_t    m_alignInt;
+		void	   *m_alignPointer;
+	};
+
+	/* Arenas are owned by a single Consumer and are not copied. */
+	EventArena(const EventArena &);
+	EventArena &operator=(const EventArena &);
+
+	/** Carve an allocation of size bytes, plus its Header. */
+	Header *Carve(size_t size);
+
+	/** Account for a freed allocation, rewinding if none remain. */
+	void Release();
+
+	/** \return  The first usable byte of chunk. */
+	static char *ChunkData(Chunk *chunk);
+
+	/** Round size up to a multiple of the Header size. */
+	static size_t Align(size_t size);
+
+	/** See HeapAllocations(). */
+	static uint64_t s_heapAllocations;
+
+	/** The size of chunks allocated to serve small requests. */
+	size_t		m_chunkSize;
+
+	/** All chunks owned by the arena, in the order they are used. */
+	Chunk	       *m_chunks;
+
+	/** The last chunk of m_chunks, or NULL. */
+	Chunk	       *m_lastChunk;
+
+	/** The chunk currently being carved, or NULL. */
+	Chunk	       *m_current;
+
+	/** Offset of the next allocation within m_current. */
+	size_t		m_offset;
+
+	/** See LiveAllocations(). */
+	size_t		m_live;
+
+	/** See Allocations(). */
+	uint64_t	m_allocations;
+
+	/** See ChunkAllocations(). */
+	uint64_t	m_chunkAllocations;
+};
+
+//- EventArena Inline Public Methods -------------------------------------------
+inline uint64_t
+EventArena::HeapAllocations()
+{
+	return (s_heapAllocations);
+}
+
+inline uint64_t
+EventArena::Allocations() const
+{
+	return (m_allocations);
+}
+
+inline uint64_t
+EventArena::ChunkAllocations() const
+{
+	return (m_chunkAllocations);
+}
+
+inline size_t
+EventArena::LiveAllocations() const
+{
+	return (m_live);
+}
+
+} // namespace DevCtl
+#endif	/* _DEVCTL_EVENT_ARENA_H_ */
@@ -38,14 +38,19 @@
 #include <sys/time.h>
 
 #include <cstddef>
+#include <cstring>
 #include <err.h>
 #include <errno.h>
 #include <syslog.h>
 
+#include <algorithm>
 #include <iostream>
-#include <sstream>
+#include <new>
 #include <string>
+#include <vector>
 
+#include "string_view.h"
+#include "event_clock.h"
 #include "event_buffer.h"
 #include "exception.h"
 #include "reader.h"
@@ -54,7 +59,6 @@ __FBSDID("$FreeBSD$");
 
 /*============================ Namespace Control =============================*/
 using std::string;
-using std::stringstream;
 namespace DevCtl
 {
 
@@ -77,50 +81,115 @@ const char EventBuffer::s_eventEndTokens[] = "\n";
 const char EventBuffer::s_keyPairSepTokens[] = " \t\n";
 
 //- EventBuffer Public Methods -------------------------------------------------
-EventBuffer::EventBuffer(Reader& reader)
- : m_reader(reader),
+EventBuffer::EventBuffer(Reader& reader, size_t maxEventSize,
+			 EventClock::Source clockSource)
+ : m_buf(new char[EVENT_BUFSIZE]),
+   m_bufSize(EVENT_BUFSIZE),
+   m_eventBuf(new char[MAX_EVENT_SIZE + EVENT_SLACK]),
+   m_eventBufSize(MAX_EVENT_SIZE + EVENT_SLACK),
+   m_maxEventSize(MAX_EVENT_SIZE),
+   m_eventSizeCap(std::max(maxEventSize, (size_t)MAX_EVENT_SIZE)),
+   m_growCount(0),
+   m_truncateCount(0),
+   m_reader(reader),
    m_validLen(0),
    m_parsedLen(0),
    m_nextEventOffset(0),
-   m_synchronized(true)
+   m_synchronized(true),
+   m_clock(clockSource)
 {
 }
 
+EventBuffer::~EventBuffer()
+{
+	delete [] m_buf;
+	delete [] m_eventBuf;
+}
+
 bool
 EventBuffer::ExtractEvent(string &eventString)
 {
-	stringstream tsField;
-	timeval now;
+	StringView eventView;
 
-	gettimeofday(&now, NULL);
-	tsField << " timestamp=" << now.tv_sec;
+	if (!ExtractEvent(eventView))
+		return (false);
 
-	while (UnParsed() > 0 || Fill()) {
+	eventString.assign(eventView.data(), eventView.length());
+	return (true);
+}
+
+bool
+EventBuffer::ExtractEvent(StringView &eventView)
+{
+	size_t avail;
+
+	m_clock.Expire();
+	if (m_reader.peek(avail) != NULL)
+		return (ExtractDirectEvent(eventView));
+
+	do {
+		if (ExtractBufferedEvent(eventView))
+			return (true);
+	} while (Fill());
+
+	return (false);
+}
+
+size_t
+EventBuffer::ExtractEvents(std::vector<string> &events)
+{
+	size_t numEvents(0);
+	size_t avail;
+	bool   direct(m_reader.peek(avail) != NULL);
+
+	m_clock.Expire();
+	if (!direct)
+		Fill();
+	for (;;) {
+		StringView eventView;
+
+		if (direct ? !ExtractDirectEvent(eventView)
+			   : !ExtractBufferedEvent(eventView))
+			break;
+		events.push_back(string(eventView.data(), eventView.length()));
+		numEvents++;
+	}
+	return (numEvents);
+}
+
+//- EventBuffer Private Methods ------------------------------------------------
+bool
+EventBuffer::LocateEvent(size_t &start, size_t &len, bool &truncated)
+{
+	while (UnParsed() > 0) {
 
 		/*
 		 * If the valid data in the buffer isn't enough to hold
-		 * a full event, try reading more.
+		 * a full event, try reading more.  The data is left
+		 * unparsed so that it is scanned, along with whatever
+		 * follows it, once more data arrives.
 		 */
-		if (NextEventMaxLen() < MIN_EVENT_SIZE) {
-			m_parsedLen += UnParsed();
-			continue;
-		}
+		if (NextEventMaxLen() < MIN_EVENT_SIZE)
+			break;
 
-		char  *nextEvent(m_buf + m_nextEventOffset);
-		bool   truncated(true);
-		size_t eventLen(strcspn(nextEvent, s_eventEndTokens));
+		size_t scanLen(std::min(UnParsed(), m_maxEventSize
+					- (m_parsedLen - m_nextEventOffset)));
+		size_t scanEnd(m_parsedLen + scanLen);
+		size_t eventEnd(Scan(scanLen));
 
 		if (!m_synchronized) {
 			/* Discard data until an end token is read. */
-			if (nextEvent[eventLen] != '\0')
+			if (eventEnd != scanEnd) {
 				m_synchronized = true;
-			m_nextEventOffset += eventLen;
+				eventEnd++;
+			}
+			m_nextEventOffset = eventEnd;
 			m_parsedLen = m_nextEventOffset;
 			continue;
-		} else if (nextEvent[eventLen] == '\0') {
+		} else if (eventEnd == scanEnd) {
 
-			m_parsedLen += eventLen;
-			if (m_parsedLen < MAX_EVENT_SIZE) {
+			len = m_parsedLen - m_nextEventOffset;
+			if (len < m_maxEventSize || Grow()) {
 				/*
 				 * Ran out of buffer before hitting
 				 * a full event. Fill() and try again.
@@ -130,72 +199,199 @@ EventBuffer::ExtractEvent(string &eventString)
 			syslog(LOG_WARNING, "Overran event buffer\n\tm_nextEventOffset"
 			       "=%zd\n\tm_parsedLen=%zd\n\tm_validLen=%zd",
 			       m_nextEventOffset, m_parsedLen, m_validLen);
+			truncated = true;
 		} else {
 			/*
 			 * Include the normal terminator in the extracted
 			 * event data.
 			 */
-			eventLen += 1;
+			len = eventEnd + 1 - m_nextEventOffset;
 			truncated = false;
 		}
 
-		m_nextEventOffset += eventLen;
+		start = m_nextEventOffset;
+
+		m_nextEventOffset += len;
 		m_parsedLen = m_nextEventOffset;
-		eventString.assign(nextEvent, eventLen);
+		return (true);
+	}
+	return (false);
+}
 
-		if (truncated) {
-			size_t fieldEnd;
-
-			/* Break cleanly at the end of a key<=>value pair. */
-			fieldEnd = eventString.find_last_of(s_keyPairSepTokens);
-			if (fieldEnd != string::npos)
-				eventString.erase(fieldEnd);
-			eventString += '\n';
-
-			m_synchronized = false;
-			syslog(LOG_WARNING,
-			       "Truncated %zd characters from event.",
-			       eventLen - fieldEnd);
+bool
+EventBuffer::ExtractBufferedEvent(StringView &eventView)
+{
+	size_t start;
+	size_t eventLen;
+	bool   truncated;
+
+	if (!LocateEvent(start, eventLen, truncated))
+		return (false);
+
+	/*
+	 * Complete events that are contiguous in the ring buffer
+	 * are handed out in place.
+	 */
+	if (!truncated && Index(start) + eventLen <= m_bufSize) {
+		eventView = StringView(m_buf + Index(start), eventLen);
+		return (true);
+	}
+
+	CopyOut(start, eventLen, m_eventBuf);
+	eventView = FinishEvent(eventLen, truncated);
+	return (true);
+}
+
+bool
+EventBuffer::ExtractDirectEvent(StringView &eventView)
+{
+	const char *data;
+	size_t	    avail;
+
+	data = m_reader.peek(avail);
+	while (avail > 0) {
+		size_t	    scanLen(std::min(avail, m_maxEventSize));
+		const char *end(static_cast<const char *>(
+				    memchr(data, '\n', scanLen)));
+		size_t	    len;
+
+		if (!m_synchronized) {
+			/* Discard data until an end token is read. */
+			len = scanLen;
+			if (end != NULL) {
+				m_synchronized = true;
+				len = end + 1 - data;
+			}
+			m_reader.consume(len);
+			data  += len;
+			avail -= len;
+			continue;
 		}
 
-		/*
-		 * Add a timestamp as the final field of the event if it is
-		 * not already present.
-		 */
-		if (eventString.find("timestamp=") == string::npos) {
-			size_t eventEnd(eventString.find_last_not_of('\n') + 1);
+		bool truncated(end == NULL);
+
+		if (truncated) {
+			/* Partial event.  Wait for more data. */
+			if (avail < m_maxEventSize)
+				return (false);
+			if (Grow())
+				continue;
+			len = scanLen;
+		} else {
+			len = end + 1 - data;
+		}
 
-			eventString.insert(eventEnd, tsField.str());
+		m_reader.consume(len);
+		if (!truncated) {
+			/* Hand out the event in place. */
+			eventView = StringView(data, len);
+			return (true);
 		}
 
+		memcpy(m_eventBuf, data, len);
+		eventView = FinishEvent(len, truncated);
 		return (true);
 	}
 	return (false);
 }
 
-//- EventBuffer Private Methods ------------------------------------------------
+StringView
+EventBuffer::FinishEvent(size_t eventLen, bool truncated)
+{
+	size_t len(eventLen);
+
+	if (truncated) {
+		size_t fieldEnd;
+
+		/* Break cleanly at the end of a key<=>value pair. */
+		fieldEnd = StringView(m_eventBuf, len)
+		    .find_last_of(s_keyPairSepTokens);
+		if (fieldEnd != StringView::npos)
+			len = fieldEnd;
+		m_eventBuf[len++] = '\n';
+
+		m_synchronized = false;
+		m_truncateCount++;
+		syslog(LOG_WARNING,
+		       "Truncated %zd characters from event.",
+		       eventLen - fieldEnd);
+	}
+
+	return (StringView(m_eventBuf, len));
+}
+
+size_t
+EventBuffer::Scan(size_t len)
+{
+	size_t scanEnd(m_parsedLen + len);
+
+	while (m_parsedLen != scanEnd) {
+		size_t	    index(Index(m_parsedLen));
+		size_t	    segLen(std::min(scanEnd - m_parsedLen,
+					    m_bufSize - index));
+		const char *end(static_cast<const char *>(
+				    memchr(m_buf + index, '\n', segLen)));
+
+		if (end != NULL) {
+			m_parsedLen += end - (m_buf + index);
+			return (m_parsedLen);
+		}
+
+		/* Continue the search from the start of the ring. */
+		m_parsedLen += segLen;
+	}
+	return (m_parsedLen);
+}
+
+void
+EventBuffer::CopyOut(size_t start, size_t len, char *dest) const
+{
+	size_t index(Index(start));
+	size_t firstLen(std::min(len, m_bufSize - index));
+
+	memcpy(dest, m_buf + index, firstLen);
+	memcpy(dest + firstLen, m_buf, len - firstLen);
+}
+
 bool
 EventBuffer::Fill()
 {
 	ssize_t avail;
 	ssize_t consumed(0);
 
-	/* Compact the buffer. */
-	if (m_nextEventOffset != 0) {
-		memmove(m_buf, m_buf + m_nextEventOffset,
-			m_validLen - m_nextEventOffset);
-		m_validLen -= m_nextEventOffset;
-		m_parsedLen -= m_nextEventOffset;
-		m_nextEventOffset = 0;
+	/*
+	 * Fill any empty space.  Only the contiguous space up to the
+	 * end of the ring is filled by a single call.  Space that wraps
+	 * around to the start of the ring is filled by the next call.
+	 */
+	if (m_reader.nonblocking()) {
+		/*
+		 * Attempt to fill all free space with a single read.
+		 * EAGAIN, rather than in_avail(), tells us when the
+		 * Reader has been drained.
+		 */
+		size_t index(Index(m_validLen));
+
+		consumed = m_reader.read(m_buf + index,
+					 std::min(Free(), m_bufSize - index));
+		if (consumed == -1) {
+			if (errno == EAGAIN || errno == EWOULDBLOCK
+			 || errno == EINTR)
+				return (false);
+			err(1, "EventBuffer::Fill(): Read failed");
+		}
+		m_validLen += consumed;
+		return (consumed > 0);
 	}
 
-	/* Fill any empty space. */
 	avail = m_reader.in_avail();
 	if (avail > 0) {
+		size_t index(Index(m_validLen));
 		size_t want;
 
-		want = std::min((size_t)avail, MAX_READ_SIZE - m_validLen);
-		consumed = m_reader.read(m_buf + m_validLen, want);
+		want = std::min((size_t)avail, Free());
+		want = std::min(want, m_bufSize - index);
+		consumed = m_reader.read(m_buf + index, want);
 		if (consumed == -1) {
 			if (errno == EINTR)
 				return (false);
@@ -207,10 +403,56 @@ EventBuffer::Fill()
 	}
 
 	m_validLen += consumed;
-	/* Guarantee our buffer is always NUL terminated. */
-	m_buf[m_validLen] = '\0';
 
 	return (consumed > 0);
 }
 
+bool
+EventBuffer::Grow()
+{
+	size_t newMaxEventSize(std::min(2 * m_maxEventSize, m_eventSizeCap));
+	size_t newBufSize(m_bufSize);
+	size_t liveLen(NextEventMaxLen());
+	char  *newBuf;
+	char  *newEventBuf;
+
+	if (newMaxEventSize <= m_maxEventSize)
+		return (false);
+
+	while (newBufSize < 2 * newMaxEventSize)
+		newBufSize *= 2;
+
+	newBuf = new (std::nothrow) char[newBufSize];
+	newEventBuf = new (std::nothrow) char[newMaxEventSize + EVENT_SLACK];
+	if (newBuf == NULL || newEventBuf == NULL) {
+		syslog(LOG_WARNING, "EventBuffer::Grow(): Unable to allocate "
+		       "%zd bytes.  Truncating large events.",
+		       newBufSize + newMaxEventSize + EVENT_SLACK);
+		delete [] newBuf;
+		delete [] newEventBuf;
+		m_eventSizeCap = m_maxEventSize;
+		return (false);
+	}
+
+	/*
+	 * Move the live data to the front of the new buffer and
+	 * rebase all stream offsets to match.
+	 */
+	CopyOut(m_nextEventOffset, liveLen, newBuf);
+	m_validLen        -= m_nextEventOffset;
+	m_parsedLen       -= m_nextEventOffset;
+	m_nextEventOffset  = 0;
+
+	delete [] m_buf;
+	delete [] m_eventBuf;
+	m_buf          = newBuf;
+	m_bufSize      = newBufSize;
+	m_eventBuf     = newEventBuf;
+	m_eventBufSize = newMaxEventSize + EVENT_SLACK;
+	m_maxEventSize = newMaxEventSize;
+	m_growCount++;
+
+	return (true);
+}
+
 } // namespace DevCtl
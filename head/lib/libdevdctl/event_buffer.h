@@ -34,6 +34,13 @@
 
 /**
  * \file devctl_event_buffer.h
+ *
+ * Header requirements:
+ *
+ *    #include <sys/time.h>
+ *
+ *    #include <devctl/string_view.h>
+ *    #include <devctl/event_clock.h>
  */
 #ifndef	_DEVCTL_EVENT_BUFFER_H_
 #define	_DEVCTL_EVENT_BUFFER_H_
@@ -60,7 +67,24 @@ class Reader;
  *
  * Once the program determines that the Reader is ready for reading, the
  * EventBuffer::ExtractEvent() should be called in a loop until the method
- * returns false.
+ * returns false.  Alternatively, EventBuffer::ExtractEvents() can be used
+ * to retrieve all events received by a single read of the Reader as a
+ * batch.
+ *
+ * Events extracted as a StringView are not copied out of the EventBuffer.
+ * Instead the view references the ring buffer itself or, for events that
+ * must be reassembled or truncated, a scratch buffer owned by the
+ * EventBuffer.  Either way, the view remains valid only until the next
+ * call to an extraction method.
+ *
+ * When the Reader supports direct access to its input (see Reader::peek()),
+ * as MmapReader does, the ring buffer is bypassed entirely.  Events are
+ * parsed in place and complete events are handed out as views of the
+ * Reader's own data.
+ *
+ * Event data is never modified to record when it was received.  Instead,
+ * GetClock() provides the receive time of the most recently extracted
+ * events, for use with Event::CreateEventView().
  */
 class EventBuffer
 {
@@ -68,9 +92,22 @@ public:
 	/**
 	 * Constructor
 	 *
-	 * \param reader  The data source on which to buffer/parse event data.
+	 * \param reader        The data source on which to buffer/parse
+	 *                      event data.
+	 * \param maxEventSize  The largest event, in bytes, to accept
+	 *                      without truncation.  When larger than
+	 *                      MAX_EVENT_SIZE, the buffer is grown
+	 *                      geometrically, as events require, until
+	 *                      this limit is reached.  Otherwise events
+	 *                      are truncated at MAX_EVENT_SIZE.
+	 * \param clockSource   The clocks used to record the receive
+	 *                      time of events.
 	 */
-	EventBuffer(Reader& reader);
+	EventBuffer(Reader& reader, size_t maxEventSize = 0,
+		    EventClock::Source clockSource = EventClock::PRECISE);
+
+	/** Destructor */
+	~EventBuffer();
 
 	/**
 	 * Pull a single event string out of the event buffer.
@@ -82,6 +119,51 @@ public:
 	 */
 	bool ExtractEvent(std::string &eventString);
 
+	/**
+	 * Pull a single event out of the event buffer without copying
+	 * it into caller owned storage.
+	 *
+	 * \param eventView  A view of the extracted event data (if
+	 *                   available).  Valid until the next call to an
+	 *                   extraction method of this EventBuffer.
+	 *
+	 * \return  true if event data is available and eventView has
+	 *          been populated.  Otherwise false.
+	 */
+	bool ExtractEvent(StringView &eventView);
+
+	/**
+	 * Read from the Reader once and pull every complete event
+	 * string out of the event buffer.  For Readers supporting
+	 * direct access, all complete events remaining in the Reader's
+	 * input are extracted.  All events extracted by a
+	 * single call share the same receive time.
+	 *
+	 * \param events  Vector to which the extracted events are
+	 *                appended.
+	 *
+	 * \return  The number of events appended to events.
+	 */
+	size_t ExtractEvents(std::vector<std::string> &events);
+
+	/**
+	 * \return  The number of times the buffer has been grown to
+	 *          accommodate a large event.
+	 */
+	uint64_t GetGrowCount()				const;
+
+	/**
+	 * \return  The number of events that have been truncated
+	 *          because they exceeded the maximum event size.
+	 */
+	uint64_t GetTruncateCount()			const;
+
+	/**
+	 * \return  The clock holding the receive time of the events
+	 *          extracted by the most recent extraction call.
+	 */
+	EventClock &GetClock();
+
 private:
 	enum {
 		/**
@@ -92,37 +174,132 @@ private:
 		MIN_EVENT_SIZE = 2,
 
 		/*
-		 * The maximum event size supported by ZFSD.
-		 * Events larger than this size (minus 1) are
+		 * The default maximum event size supported by ZFSD.
+		 * Events larger than the maximum size (minus 1) are
 		 * truncated at the end of the last fully received
 		 * key/value pair.
 		 */
 		MAX_EVENT_SIZE = 8192,
 
 		/**
-		 * The maximum amount of buffer data to read at
-		 * a single time from the Devd file descriptor.
+		 * The initial size of EventBuffer's ring buffer of Devd
+		 * event data.  The ring size must always be a power of two
+		 * so that ring offsets can be reduced with a mask, and must
+		 * be larger than the maximum event size so that a
+		 * maximally sized partial event never prevents further
+		 * reads.
 		 */
-		MAX_READ_SIZE = MAX_EVENT_SIZE,
+		EVENT_BUFSIZE = 2 * MAX_EVENT_SIZE,
 
 		/**
-		 * The size of EventBuffer's buffer of Devd event data.
-		 * This is one larger than the maximum supported event
-		 * size, which alows us to always include a terminating
-		 * NUL without overwriting any received data.
+		 * Space reserved in m_eventBuf, beyond the maximum event
+		 * size, for an event terminator.
 		 */
-		EVENT_BUFSIZE = MAX_EVENT_SIZE + /*NUL*/1
+		EVENT_SLACK = 1
 	};
 
+	/* Not copyable. */
+	EventBuffer(const EventBuffer &);
+	EventBuffer &operator=(const EventBuffer &);
+
+	/** Convert a stream offset into an index into m_buf. */
+	size_t Index(size_t offset)  const;
+
 	/** The amount of data in m_buf we have yet to look at. */
 	size_t UnParsed()        const;
 
 	/** The amount of data in m_buf available for the next event. */
 	size_t NextEventMaxLen() const;
 
+	/** The amount of empty space in m_buf. */
+	size_t Free()            const;
+
+	/**
+	 * Scan unparsed data in the ring buffer for the end of the
+	 * current event.  Each byte of buffered data is examined only
+	 * once, no matter how many Fill() calls it takes to receive a
+	 * full event.
+	 *
+	 * \param len  The number of bytes, starting at m_parsedLen,
+	 *             to scan.
+	 *
+	 * \return  The stream offset of the event's end token, or
+	 *          m_parsedLen + len if it was not found.
+	 */
+	size_t Scan(size_t len);
+
+	/**
+	 * Copy data out of the ring buffer into linear memory,
+	 * reassembling any data that wraps around the end of m_buf.
+	 *
+	 * \param start  Stream offset of the first byte to copy.
+	 * \param len    The number of bytes to copy.
+	 * \param dest   Destination for the data.  Must have room for
+	 *               len bytes.
+	 */
+	void   CopyOut(size_t start, size_t len, char *dest)       const;
+
+	/**
+	 * Find the next complete event in the data already held in the
+	 * event buffer without reading from the Reader, and mark it as
+	 * consumed.
+	 *
+	 * \param[out] start      Stream offset of the event.
+	 * \param[out] len        The length of the event.
+	 * \param[out] truncated  The event exceeded the maximum
+	 *                        event size and must be truncated.
+	 *
+	 * \return  true if an event was found.  Otherwise false.
+	 */
+	bool LocateEvent(size_t &start, size_t &len, bool &truncated);
+
+	/**
+	 * Pull a single event out of the data already held in the
+	 * event buffer without reading from the Reader.
+	 *
+	 * \param eventView  A view of the extracted event data (if
+	 *                   available).
+	 *
+	 * \return  true if event data is available and eventView has
+	 *          been populated.  Otherwise false.
+	 */
+	bool ExtractBufferedEvent(StringView &eventView);
+
+	/**
+	 * Pull a single event directly out of the Reader's input, as
+	 * returned by Reader::peek(), bypassing the ring buffer.
+	 *
+	 * \param eventView  A view of the extracted event data (if
+	 *                   available).
+	 *
+	 * \return  true if event data is available and eventView has
+	 *          been populated.  Otherwise false.
+	 */
+	bool ExtractDirectEvent(StringView &eventView);
+
+	/**
+	 * Truncate, if required, an event that has been copied to the
+	 * start of m_eventBuf.
+	 *
+	 * \param eventLen   The length of the event in m_eventBuf.
+	 * \param truncated  The event must be truncated.
+	 *
+	 * \return  A view of the finished event in m_eventBuf.
+	 */
+	StringView FinishEvent(size_t eventLen, bool truncated);
+
 	/** Fill the event buffer with event data from Devd. */
 	bool Fill();
 
+	/**
+	 * Double the maximum event size, up to m_eventSizeCap, and
+	 * reallocate m_buf to match.  The grown buffer is retained and
+	 * reused for all subsequent events.
+	 *
+	 * \return  true if the buffer was grown.  Otherwise false.
+	 */
+	bool Grow();
+
 	/** Characters we treat as beginning an event string. */
 	static const char   s_eventStartTokens[];
 
@@ -132,15 +309,20 @@ private:
 	/** Characters found between successive "key=value" strings. */
 	static const char   s_keyPairSepTokens[];
 
-	/** Temporary space for event data during our parsing.  Laid out like
-	 * this:
+	/**
+	 * Ring buffer of event data awaiting parsing.  All offsets
+	 * tracked by the EventBuffer are offsets into the data stream,
+	 * which only ever increase.  They are mapped into m_buf by masking
+	 * with m_bufSize - 1, so consuming an event never requires the
+	 * remaining data to be moved.  Laid out like this:
+	 *
 	 *         <--------------------------------------------------------->
-	 *         |         |    |           |                              |
-	 * m_buf---|         |    |           |                              |
-	 * m_nextEventOffset--    |           |                              |
-	 * m_parsedLen-------------           |                              |
-	 * m_validLen--------------------------                              |
-	 * EVENT_BUFSIZE------------------------------------------------------
+	 *         |              |    |           |                         |
+	 * m_buf---|              |    |           |                         |
+	 * m_nextEventOffset-------    |           |                         |
+	 * m_parsedLen------------------           |                         |
+	 * m_validLen-------------------------------                         |
+	 * m_bufSize----------------------------------------------------------
 	 *
 	 * Data before m_nextEventOffset has already been processed.
 	 *
@@ -150,28 +332,80 @@ private:
 	 * Data between m_parsedLen and m_validLen has been read from the
 	 * source, but not yet parsed.
 	 *
-	 * Between m_validLen and EVENT_BUFSIZE is empty space.
-	 *
-	 * */
-	char		    m_buf[EVENT_BUFSIZE];
+	 * The remainder of the ring, from m_validLen wrapping around to
+	 * m_nextEventOffset, is empty space.
+	 */
+	char		   *m_buf;
+
+	/** The size of m_buf.  Always a power of two. */
+	size_t		    m_bufSize;
+
+	/**
+	 * Scratch space in which events that wrap around the end of
+	 * m_buf, or are truncated, are assembled.
+	 */
+	char		   *m_eventBuf;
+
+	/** The size of m_eventBuf.  m_maxEventSize + EVENT_SLACK. */
+	size_t		    m_eventBufSize;
+
+	/** The size at which events are currently grown or truncated. */
+	size_t		    m_maxEventSize;
+
+	/** The largest size to which m_maxEventSize may grow. */
+	size_t		    m_eventSizeCap;
+
+	/** The number of times m_buf has been grown. */
+	uint64_t	    m_growCount;
+
+	/** The number of events truncated for exceeding m_maxEventSize. */
+	uint64_t	    m_truncateCount;
 
 	/** Reference to the reader linked to devd's domain socket. */
 	Reader&		    m_reader;
 
-	/** Offset within m_buf to the beginning of free space. */
+	/** Stream offset to the beginning of free space. */
 	size_t		    m_validLen;
 
-	/** Offset within m_buf to the beginning of data not yet parsed */
+	/** Stream offset to the beginning of data not yet parsed */
 	size_t		    m_parsedLen;
 
-	/** Offset within m_buf to the start token of the next event. */
+	/** Stream offset to the start token of the next event. */
 	size_t		    m_nextEventOffset;
 
 	/** The EventBuffer is aligned and tracking event records. */
 	bool		    m_synchronized;
+
+	/** Source of the receive time of extracted events. */
+	EventClock	    m_clock;
 };
 
+//- EventBuffer Inline Public Methods ------------------------------------------
+inline uint64_t
+EventBuffer::GetGrowCount() const
+{
+	return (m_growCount);
+}
+
+inline uint64_t
+EventBuffer::GetTruncateCount() const
+{
+	return (m_truncateCount);
+}
+
+inline EventClock &
+EventBuffer::GetClock()
+{
+	return (m_clock);
+}
+
 //- EventBuffer Inline Private Methods -----------------------------------------
+inline size_t
+EventBuffer::Index(size_t offset) const
+{
+	return (offset & (m_bufSize - 1));
+}
+
 inline size_t
 EventBuffer::UnParsed() const
 {
@@ -184,5 +418,11 @@ EventBuffer::NextEventMaxLen() const
 	return (m_validLen - m_nextEventOffset);
 }
 
+inline size_t
+EventBuffer::Free() const
+{
+	return (m_bufSize - NextEventMaxLen());
+}
+
 } // namespace DevCtl
 #endif	/* _DEVCTL_EVENT_BUFFER_H_ */
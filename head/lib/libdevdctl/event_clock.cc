@@ -0,0 +1,95 @@
+/*-
+ * Copyright (c) 2012, 2013 Spectra Logic Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions, and the following disclaimer,
+ *    without modification.
+ * 2. Redistributions in binary form must reproduce at minimum a disclaimer
+ *    substantially similar to the "NO WARRANTY" disclaimer below
+ *    ("Disclaimer") and any redistribution must be conditioned upon
+ *    including a substantially similar Disclaimer requirement for further
+ *    binary redistribution.
+ *
+ * NO WARRANTY
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTIBILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDERS OR CONTRIBUTORS BE LIABLE FOR SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGES.
+ *
+ * $FreeBSD$
+ */
+
+/**
+ * \file event_clock.cc
+ *
+ * Implementation of the EventClock class.
+ */
+#include <sys/cdefs.h>
+#include <sys/time.h>
+
+#include <err.h>
+#include <time.h>
+
+#include "event_clock.h"
+
+__FBSDID("$FreeBSD$");
+/*============================ Namespace Control =============================*/
+namespace DevCtl
+{
+
+/*=========================== Class Implementations ==========================*/
+/*-------------------------------- EventClock --------------------------------*/
+//- EventClock Public Methods --------------------------------------------------
+EventClock::EventClock(Source source)
+ : m_clockId(CLOCK_REALTIME),
+   m_monotonicId(CLOCK_MONOTONIC),
+   m_haveNow(false),
+   m_haveReceiveTime(false)
+{
+	m_now.tv_sec = 0;
+	m_now.tv_nsec = 0;
+	m_receiveTime.tv_sec = 0;
+	m_receiveTime.tv_nsec = 0;
+	if (source == COARSE) {
+#if defined(CLOCK_REALTIME_COARSE)
+		m_clockId = CLOCK_REALTIME_COARSE;
+#elif defined(CLOCK_REALTIME_FAST)
+		m_clockId = CLOCK_REALTIME_FAST;
+#endif
+#if defined(CLOCK_MONOTONIC_COARSE)
+		m_monotonicId = CLOCK_MONOTONIC_COARSE;
+#elif defined(CLOCK_MONOTONIC_FAST)
+		m_monotonicId = CLOCK_MONOTONIC_FAST;
+#endif
+	}
+}
+
+//- EventClock Private Methods -------------------------------------------------
+void
+EventClock::RefreshNow()
+{
+	if (clock_gettime(m_clockId, &m_now) != 0)
+		err(1, "clock_gettime");
+	m_haveNow = true;
+}
+
+void
+EventClock::RefreshReceiveTime()
+{
+	if (clock_gettime(m_monotonicId, &m_receiveTime) != 0)
+		err(1, "clock_gettime");
+	m_haveReceiveTime = true;
+}
+
+} // namespace DevCtl
@@ -0,0 +1,158 @@
+/*-
+ * Copyright (c) 2012, 2013 Spectra Logic Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions, and the following disclaimer,
+ *    without modification.
+ * 2. Redistributions in binary form must reproduce at minimum a disclaimer
+ *    substantially similar to the "NO WARRANTY" disclaimer below
+ *    ("Disclaimer") and any redistribution must be conditioned upon
+ *    including a substantially similar Disclaimer requirement for further
+ *    binary redistribution.
+ *
+ * NO WARRANTY
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTIBILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDERS OR CONTRIBUTORS BE LIABLE FOR SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGES.
+ *
+ * $FreeBSD$
+ */
+
+/**
+ * \file devctl_event_clock.h
+ *
+ * Definition of the EventClock class.
+ *
+ * Header requirements:
+ *
+ *    #include <sys/time.h>
+ */
+#ifndef	_DEVCTL_EVENT_CLOCK_H_
+#define	_DEVCTL_EVENT_CLOCK_H_
+
+/*============================ Namespace Control =============================*/
+namespace DevCtl
+{
+
+/*============================= Class Definitions ============================*/
+/*-------------------------------- EventClock --------------------------------*/
+/**
+ * \brief Cached source of receive times for event data.
+ *
+ * Events received together are given the same receive time.  Rather than
+ * reading the clock for each event, an EventClock is expired once per
+ * batch of events.  The clock is then read at most once:  the first time
+ * a receive time is actually needed.
+ *
+ * Each batch has two receive times.  The wall clock time stamps events
+ * that do not carry a timestamp of their own.  The monotonic time, against
+ * which the age of received events is measured, is unaffected by changes
+ * to the wall clock.
+ *
+ * Where the resolution of a clock tick suffices, the clocks can optionally
+ * be read with their cheaper, coarse grained, variants.
+ */
+class EventClock
+{
+public:
+	/** The clocks used to stamp events. */
+	enum Source {
+		/** CLOCK_REALTIME and CLOCK_MONOTONIC */
+		PRECISE,
+
+		/**
+		 * The _COARSE, or _FAST, variants of CLOCK_REALTIME and
+		 * CLOCK_MONOTONIC, where available.  Otherwise PRECISE.
+		 */
+		COARSE
+	};
+
+	/**
+	 * Constructor
+	 *
+	 * \param source  The clocks to read.
+	 */
+	EventClock(Source source = PRECISE);
+
+	/**
+	 * Discard the cached times.  Call once at the start of each
+	 * batch of events.
+	 */
+	void Expire();
+
+	/**
+	 * \return  The wall clock time at which the current batch was
+	 *          received.
+	 */
+	const timespec &Now();
+
+	/**
+	 * \return  The monotonic time at which the current batch was
+	 *          received.  Comparable with CLOCK_MONOTONIC.
+	 */
+	const timespec &ReceiveTime();
+
+private:
+	/** Read the wall clock into m_now. */
+	void RefreshNow();
+
+	/** Read the monotonic clock into m_receiveTime. */
+	void RefreshReceiveTime();
+
+	/** The clock read by RefreshNow(). */
+	clockid_t	m_clockId;
+
+	/** The clock read by RefreshReceiveTime(). */
+	clockid_t	m_monotonicId;
+
+	/** m_now reflects the current batch. */
+	bool		m_haveNow;
+
+	/** m_receiveTime reflects the current batch. */
+	bool		m_haveReceiveTime;
+
+	/** The wall clock time at which the current batch was received. */
+	timespec	m_now;
+
+	/** The monotonic time at which the current batch was received. */
+	timespec	m_receiveTime;
+};
+
+//- EventClock Inline Public Methods -------------------------------------------
+inline void
+EventClock::Expire()
+{
+	m_haveNow = false;
+	m_haveReceiveTime = false;
+}
+
+inline const timespec &
+EventClock::Now()
+{
+	if (!m_haveNow)
+		RefreshNow();
+	return (m_now);
+}
+
+inline const timespec &
+EventClock::ReceiveTime()
+{
+	if (!m_haveReceiveTime)
+		RefreshReceiveTime();
+	return (m_receiveTime);
+}
+
+} // namespace DevCtl
+#endif	/* _DEVCTL_EVENT_CLOCK_H_ */
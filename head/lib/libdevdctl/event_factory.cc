@@ -36,13 +36,18 @@
 #include <sys/cdefs.h>
 #include <sys/time.h>
 
+#include <algorithm>
+#include <cstring>
 #include <list>
 #include <map>
 #include <string>
+#include <vector>
 
 #include "guid.h"
+#include "string_view.h"
 #include "event.h"
 #include "event_factory.h"
+#include "exception.h"
 
 __FBSDID("$FreeBSD$");
 
@@ -53,21 +58,59 @@ __FBSDID("$FreeBSD$");
 namespace DevCtl
 {
 
+/*============================ File Scoped Functions =========================*/
+/**
+ * \return  true if value matches a subscription condition's pattern.
+ */
+static inline bool
+ValueMatches(const StringView &value, const std::string &pattern, bool prefix)
+{
+	if (!prefix)
+		return (value == StringView(pattern));
+
+	return (value.length() >= pattern.length()
+	     && memcmp(value.data(), pattern.data(), pattern.length()) == 0);
+}
+
 /*=========================== Class Implementations ==========================*/
 /*------------------------------- EventFactory -------------------------------*/
 //- Event Public Methods -------------------------------------------------------
 EventFactory::EventFactory(Event::BuildMethod *defaultBuildMethod)
- : m_defaultBuildMethod(defaultBuildMethod)
+ : m_defaultBuildMethod(defaultBuildMethod),
+   m_dispatchSeed(0)
+{
+	RebuildDispatchTable();
+}
+
+EventFactory::EventFactory(const EventFactory &src)
+ : m_registry(src.m_registry),
+   m_defaultBuildMethod(src.m_defaultBuildMethod),
+   m_dispatchSeed(0),
+   m_subscriptions(src.m_subscriptions)
 {
+	/* The dispatch table references the strings of m_registry. */
+	RebuildDispatchTable();
+}
+
+EventFactory &
+EventFactory::operator=(const EventFactory &rhs)
+{
+	if (this != &rhs) {
+		m_registry = rhs.m_registry;
+		m_defaultBuildMethod = rhs.m_defaultBuildMethod;
+		m_subscriptions = rhs.m_subscriptions;
+		RebuildDispatchTable();
+	}
+	return (*this);
 }
 
 void
 EventFactory::UpdateRegistry(Record regEntries[], size_t numEntries)
 {
 	EventFactory::Record *rec(regEntries);
-	EventFactory::Record *lastRec(rec + numEntries - 1);
+	EventFactory::Record *lastRec(rec + numEntries);
 
-	for (; rec <= lastRec; rec++) {
+	for (; rec < lastRec; rec++) {
 		Key key(rec->m_type, rec->m_subsystem);
 
 		if (rec->m_buildMethod == NULL)
@@ -75,19 +118,61 @@ EventFactory::UpdateRegistry(Record regEntries[], size_t numEntries)
 		else
 			m_registry[key] = rec->m_buildMethod;
 	}
+	RebuildDispatchTable();
+}
+
+void
+EventFactory::Subscribe(const Subscription subscriptions[],
+			size_t numSubscriptions)
+{
+	const Subscription *sub(subscriptions);
+	const Subscription *lastSub(sub + numSubscriptions);
+
+	for (; sub < lastSub; sub++) {
+		RuleList	&rules(m_subscriptions[Key(sub->m_type,
+							   sub->m_subsystem)]);
+		SubscriptionRule rule;
+
+		rule.m_conditions = ParseConditions(sub->m_conditions);
+		rule.m_buildMethod = sub->m_buildMethod;
+
+		RuleList::iterator existing(rules.begin());
+		for (; existing != rules.end(); existing++) {
+			if (!RulePrecedes(*existing, rule)
+			 && !RulePrecedes(rule, *existing))
+				break;
+		}
+
+		if (existing != rules.end()) {
+			existing->m_buildMethod = rule.m_buildMethod;
+		} else {
+			/* Keep rules in order of precedence. */
+			RuleList::iterator pos;
+
+			pos = std::upper_bound(rules.begin(), rules.end(),
+					       rule, RulePrecedes);
+			rules.insert(pos, rule);
+		}
+	}
+	RebuildDispatchTable();
 }
 
 Event *
 EventFactory::Build(Event::Type type, NVPairMap &nvpairs,
-		    const std::string eventString) const
+		    const StringView &eventString) const
 {
-	Key key(type, nvpairs["system"]);
-	Event::BuildMethod *buildMethod(m_defaultBuildMethod);
+	const DispatchEntry *entry(Find(type, nvpairs.Value(KEY_SYSTEM)));
+	Event::BuildMethod  *buildMethod(m_defaultBuildMethod);
+
+	if (entry != NULL) {
+		if (entry->m_trieRoot == NO_NODE
+		 || !Match(entry->m_trieRoot, nvpairs, eventString,
+			   buildMethod)) {
+			if (entry->m_buildMethod != NULL)
+				buildMethod = entry->m_buildMethod;
+		}
+	}
 
-	Registry::const_iterator foundMethod(m_registry.find(key));
-	if (foundMethod != m_registry.end())
-		buildMethod = foundMethod->second;
-	
 	if (buildMethod == NULL) {
 		delete &nvpairs;
 		return (NULL);
@@ -96,4 +181,370 @@ EventFactory::Build(Event::Type type, NVPairMap &nvpairs,
 	return (buildMethod(type, nvpairs, eventString));
 }
 
+bool
+EventFactory::Accepts(Event::Type type, const StringView &system) const
+{
+	const DispatchEntry *entry;
+
+	if (m_defaultBuildMethod != NULL)
+		return (true);
+
+	entry = Find(type, system);
+	if (entry == NULL)
+		return (false);
+
+	return (entry->m_buildMethod != NULL
+	     || (entry->m_trieRoot != NO_NODE
+	      && m_trieNodes[entry->m_trieRoot].m_canBuild));
+}
+
+//- EventFactory Static Protected Methods --------------------------------------
+EventFactory::ConditionList
+EventFactory::ParseConditions(const char *conditions)
+{
+	ConditionList result;
+	StringView    text(conditions != NULL ? conditions : "");
+	size_t	      pos(0);
+
+	while (pos < text.length()) {
+		size_t end(text.find(' ', pos));
+
+		if (end == StringView::npos)
+			end = text.length();
+		if (end == pos) {
+			pos++;
+			continue;
+		}
+
+		StringView word(text.substr(pos, end - pos));
+		size_t	   equals(word.find('='));
+		Condition  condition;
+
+		if (equals == StringView::npos || equals == 0)
+			throw Exception("EventFactory: Invalid subscription "
+					"condition \"%.*s\"",
+					(int)word.length(), word.data());
+
+		condition.m_name = word.substr(0, equals).str();
+		condition.m_value = word.substr(equals + 1).str();
+		condition.m_prefix = !condition.m_value.empty()
+				  && *condition.m_value.rbegin() == '*';
+		if (condition.m_prefix)
+			condition.m_value.erase(condition.m_value.length() - 1);
+		result.push_back(condition);
+		pos = end;
+	}
+	std::sort(result.begin(), result.end(), ConditionPrecedes);
+	return (result);
+}
+
+bool
+EventFactory::ConditionPrecedes(const Condition &lhs, const Condition &rhs)
+{
+	if (lhs.m_name != rhs.m_name)
+		return (lhs.m_name < rhs.m_name);
+
+	/* Exact values, then prefixes from the longest to the shortest. */
+	if (lhs.m_prefix != rhs.m_prefix)
+		return (!lhs.m_prefix);
+	if (lhs.m_prefix && lhs.m_value.length() != rhs.m_value.length())
+		return (lhs.m_value.length() > rhs.m_value.length());
+	return (lhs.m_value < rhs.m_value);
+}
+
+bool
+EventFactory::RulePrecedes(const SubscriptionRule &lhs,
+			   const SubscriptionRule &rhs)
+{
+	const ConditionList &lhsConditions(lhs.m_conditions);
+	const ConditionList &rhsConditions(rhs.m_conditions);
+	size_t		     i(0);
+
+	for (; i < lhsConditions.size() && i < rhsConditions.size(); i++) {
+		if (ConditionPrecedes(lhsConditions[i], rhsConditions[i]))
+			return (true);
+		if (ConditionPrecedes(rhsConditions[i], lhsConditions[i]))
+			return (false);
+	}
+
+	/* Otherwise the rule with further conditions is more specific. */
+	return (lhsConditions.size() > rhsConditions.size());
+}
+
+bool
+EventFactory::ConditionEquals(const Condition &lhs, const Condition &rhs)
+{
+	return (lhs.m_name == rhs.m_name
+	     && lhs.m_prefix == rhs.m_prefix
+	     && lhs.m_value == rhs.m_value);
+}
+
+bool
+EventFactory::FieldValue(const NVPairMap &nvpairs,
+			 const StringView &eventString, EventKey key,
+			 const StringView &name, StringView &value)
+{
+	/*
+	 * Once parsed, a later occurrence of a field replaces an
+	 * earlier one, so a value in the unparsed remainder of the
+	 * event overrides any value already parsed.
+	 */
+	if (!nvpairs.FullyParsed()
+	 && Event::PeekField(eventString.substr(nvpairs.UnparsedOffset()),
+			     name, value))
+		return (true);
+
+	if (key != NUM_EVENT_KEYS) {
+		if (nvpairs.Contains(key)) {
+			value = nvpairs.Value(key);
+			return (true);
+		}
+	} else {
+		NVPairMap::const_iterator field(nvpairs.find(name));
+
+		if (field != nvpairs.end()) {
+			value = field->second;
+			return (true);
+		}
+	}
+	return (false);
+}
+
+//- EventFactory Protected Methods ---------------------------------------------
+bool
+EventFactory::Match(size_t node, const NVPairMap &nvpairs,
+		    const StringView &eventString,
+		    Event::BuildMethod *&buildMethod) const
+{
+	while (node != NO_NODE) {
+		const TrieNode &trieNode(m_trieNodes[node]);
+		StringView	value;
+
+		if (trieNode.m_field.empty()) {
+			buildMethod = trieNode.m_buildMethod;
+			return (true);
+		}
+
+		/*
+		 * Edges are ordered by precedence, and each leads to a
+		 * subtrie holding every rule that may still match, so
+		 * the first matching edge is the only one followed.
+		 */
+		node = trieNode.m_wildcard;
+		if (FieldValue(nvpairs, eventString, trieNode.m_key,
+			       trieNode.m_field, value)) {
+			const TrieEdge *edge(&m_trieEdges[
+						 trieNode.m_firstEdge]);
+			const TrieEdge *lastEdge(edge + trieNode.m_numEdges);
+
+			for (; edge < lastEdge; edge++) {
+				if (ValueMatches(value, edge->m_value,
+						 edge->m_prefix)) {
+					node = edge->m_child;
+					break;
+				}
+			}
+		}
+	}
+	return (false);
+}
+
+size_t
+EventFactory::CompileTrie(const PendingRuleList &rules)
+{
+	TrieNode	  node;
+	const std::string *field(NULL);
+	ConditionList	  edges;
+	PendingRuleList	  wildcard;
+	std::vector<TrieEdge> compiledEdges;
+
+	if (rules.empty())
+		return (NO_NODE);
+
+	node.m_key = NUM_EVENT_KEYS;
+	node.m_firstEdge = 0;
+	node.m_numEdges = 0;
+	node.m_wildcard = NO_NODE;
+	node.m_buildMethod = NULL;
+	node.m_canBuild = false;
+
+	/*
+	 * Rules are in order of precedence.  Once the preferred rule
+	 * has no conditions left to test, it is the one that matches.
+	 */
+	const PendingRule &first(rules.front());
+	if (first.m_nextCondition == first.m_rule->m_conditions.size()) {
+		node.m_buildMethod = first.m_rule->m_buildMethod;
+		node.m_canBuild = node.m_buildMethod != NULL;
+		m_trieNodes.push_back(node);
+		return (m_trieNodes.size() - 1);
+	}
+
+	/* Test the first field, in name order, that remains constrained. */
+	for (PendingRuleList::const_iterator rule(rules.begin());
+	     rule != rules.end(); rule++) {
+		const ConditionList &conditions(rule->m_rule->m_conditions);
+
+		if (rule->m_nextCondition < conditions.size()
+		 && (field == NULL
+		  || conditions[rule->m_nextCondition].m_name < *field))
+			field = &conditions[rule->m_nextCondition].m_name;
+	}
+	node.m_field = *field;
+	node.m_key = NVPairMap::LookupKey(node.m_field);
+
+	for (PendingRuleList::const_iterator rule(rules.begin());
+	     rule != rules.end(); rule++) {
+		const ConditionList &conditions(rule->m_rule->m_conditions);
+
+		if (rule->m_nextCondition < conditions.size()
+		 && conditions[rule->m_nextCondition].m_name == node.m_field)
+			edges.push_back(conditions[rule->m_nextCondition]);
+		else
+			wildcard.push_back(*rule);
+	}
+	std::sort(edges.begin(), edges.end(), ConditionPrecedes);
+	edges.erase(std::unique(edges.begin(), edges.end(), ConditionEquals),
+		    edges.end());
+
+	/*
+	 * An edge's subtrie holds the rules without a condition on the
+	 * field, and those whose condition on it is implied by the edge's:
+	 * the same exact value, or a prefix of the edge's value.
+	 */
+	for (ConditionList::const_iterator edge(edges.begin());
+	     edge != edges.end(); edge++) {
+		PendingRuleList subset;
+		TrieEdge	compiled;
+
+		for (PendingRuleList::const_iterator rule(rules.begin());
+		     rule != rules.end(); rule++) {
+			const ConditionList &conditions(
+			    rule->m_rule->m_conditions);
+			PendingRule next(*rule);
+
+			if (rule->m_nextCondition < conditions.size()
+			 && conditions[rule->m_nextCondition].m_name
+			 == node.m_field) {
+				const Condition &condition(
+				    conditions[rule->m_nextCondition]);
+
+				if (edge->m_prefix && !condition.m_prefix)
+					continue;
+				if (!ValueMatches(edge->m_value,
+						  condition.m_value,
+						  condition.m_prefix))
+					continue;
+				next.m_nextCondition++;
+			}
+			subset.push_back(next);
+		}
+
+		compiled.m_value = edge->m_value;
+		compiled.m_prefix = edge->m_prefix;
+		compiled.m_child = CompileTrie(subset);
+		compiledEdges.push_back(compiled);
+		if (compiled.m_child != NO_NODE
+		 && m_trieNodes[compiled.m_child].m_canBuild)
+			node.m_canBuild = true;
+	}
+
+	node.m_wildcard = CompileTrie(wildcard);
+	if (node.m_wildcard != NO_NODE
+	 && m_trieNodes[node.m_wildcard].m_canBuild)
+		node.m_canBuild = true;
+
+	node.m_firstEdge = m_trieEdges.size();
+	node.m_numEdges = compiledEdges.size();
+	m_trieEdges.insert(m_trieEdges.end(), compiledEdges.begin(),
+			   compiledEdges.end());
+	m_trieNodes.push_back(node);
+	return (m_trieNodes.size() - 1);
+}
+
+void
+EventFactory::RebuildDispatchTable()
+{
+	std::vector<size_t> trieRoots;
+	size_t		    tableSize(1);
+
+	m_trieNodes.clear();
+	m_trieEdges.clear();
+	for (SubscriptionMap::const_iterator group(m_subscriptions.begin());
+	     group != m_subscriptions.end(); group++) {
+		PendingRuleList rules;
+
+		for (RuleList::const_iterator rule(group->second.begin());
+		     rule != group->second.end(); rule++) {
+			PendingRule pending;
+
+			pending.m_rule = &*rule;
+			pending.m_nextCondition = 0;
+			rules.push_back(pending);
+		}
+		trieRoots.push_back(CompileTrie(rules));
+	}
+
+	while (tableSize < 2 * (m_registry.size() + m_subscriptions.size()))
+		tableSize *= 2;
+
+	for (;; tableSize *= 2) {
+		for (size_t seed(0); seed < MAX_DISPATCH_SEEDS; seed++) {
+			if (FillDispatchTable(tableSize, seed, trieRoots))
+				return;
+		}
+	}
+}
+
+bool
+EventFactory::FillDispatchTable(size_t tableSize, size_t seed,
+				const std::vector<size_t> &trieRoots)
+{
+	DispatchEntry empty;
+
+	empty.m_type = Event::NOTIFY;
+	empty.m_buildMethod = NULL;
+	empty.m_trieRoot = NO_NODE;
+	m_dispatchTable.assign(tableSize, empty);
+	m_dispatchSeed = seed;
+
+	for (Registry::const_iterator entry(m_registry.begin());
+	     entry != m_registry.end(); entry++) {
+		StringView     system(entry->first.second);
+		size_t	       index(Hash(seed, entry->first.first, system)
+				     & (tableSize - 1));
+		DispatchEntry &slot(m_dispatchTable[index]);
+
+		if (slot.m_buildMethod != NULL)
+			return (false);
+
+		slot.m_type = entry->first.first;
+		slot.m_system = system;
+		slot.m_buildMethod = entry->second;
+	}
+
+	/* Subscriptions share the slot of any registry entry for their key. */
+	std::vector<size_t>::const_iterator trieRoot(trieRoots.begin());
+	for (SubscriptionMap::const_iterator group(m_subscriptions.begin());
+	     group != m_subscriptions.end(); group++, trieRoot++) {
+		Event::Type    type(group->first.first);
+		StringView     system(group->first.second);
+		DispatchEntry &slot(m_dispatchTable[Hash(seed, type, system)
+						    & (tableSize - 1)]);
+
+		if (*trieRoot == NO_NODE)
+			continue;
+
+		if (slot.m_buildMethod != NULL || slot.m_trieRoot != NO_NODE) {
+			if (slot.m_type != type || slot.m_system != system)
+				return (false);
+		} else {
+			slot.m_type = type;
+			slot.m_system = system;
+		}
+		slot.m_trieRoot = *trieRoot;
+	}
+	return (true);
+}
+
 } // namespace DevCtl
@@ -47,6 +47,19 @@ namespace DevCtl
 /*------------------------------- EventFactory -------------------------------*/
 /**
  * \brief Container for "event type" => "event object" creaction methods.
+ *
+ * Registered build methods are dispatched through a perfect hash table
+ * keyed on event type and system.  The table is rebuilt, with a hash
+ * seed and size chosen so that no two entries share a slot, whenever
+ * the registry changes.  Dispatching an event therefore costs a single
+ * hash of its system name and at most one string comparison, and never
+ * allocates.
+ *
+ * Subscriptions refine this dispatch using the values of other fields.
+ * The subscriptions for each type and system are compiled into a
+ * decision trie whose nodes each test a single field, so that events
+ * are routed to a specialized build method, or rejected, without a
+ * full Event object being built.
  */
 class EventFactory
 {
@@ -68,20 +81,289 @@ public:
 		Event::BuildMethod *m_buildMethod;
 	};
 
+	/**
+	 * Table record of a subscription.  Events of type m_type from
+	 * system m_subsystem that satisfy all of m_conditions are built
+	 * by m_buildMethod, in preference to any registry entry.
+	 */
+	struct Subscription
+	{
+		Event::Type         m_type;
+		const char         *m_subsystem;
+
+		/**
+		 * Space separated "name=value" conditions.  A value
+		 * ending in '*' matches any value beginning with the
+		 * text that precedes the '*'.
+		 */
+		const char         *m_conditions;
+
+		/** NULL to reject the events matched. */
+		Event::BuildMethod *m_buildMethod;
+	};
+
 	const Registry &GetRegistry()				const;
 	Event *Build(Event::Type type, NVPairMap &nvpairs,
-		     const std::string eventString)		const;
+		     const StringView &eventString)		const;
+
+	/**
+	 * Determine whether Build() may construct an event of the
+	 * given type and system.  This allows events that would only
+	 * be discarded by Build() to be rejected before they are parsed.
+	 *
+	 * \param type    The type of the event.
+	 * \param system  The event's system, as returned by
+	 *                Event::PeekSystem().
+	 *
+	 * \return  True if a default build method is set, a build
+	 *          method is registered for type and system, or a
+	 *          subscription may route such events to a build method.
+	 */
+	bool Accepts(Event::Type type, const StringView &system)	const;
+
+	/**
+	 * Find the build method registered for an event type and system.
+	 *
+	 * \return  The registered build method, or NULL if there is none.
+	 *          Neither subscriptions nor the default build method
+	 *          are considered.
+	 */
+	Event::BuildMethod *Lookup(Event::Type type,
+				   const StringView &system)		const;
 
 	EventFactory(Event::BuildMethod *defaultBuildMethod = NULL);
+	EventFactory(const EventFactory &src);
+	EventFactory &operator=(const EventFactory &rhs);
 
 	void UpdateRegistry(Record regEntries[], size_t numEntries);
 
+	/**
+	 * Add subscriptions.  A subscription with the same type, system
+	 * and conditions as an existing one replaces it.
+	 *
+	 * Where several subscriptions match an event, the conditions of
+	 * each are compared in field name order.  At the first field on
+	 * which they differ, an exact value takes precedence over a
+	 * longer prefix, a longer prefix over a shorter one, and any
+	 * condition over none.  Events matching no subscription are
+	 * built as if there were none.
+	 *
+	 * \param subscriptions     The subscriptions to add.
+	 * \param numSubscriptions  The number of entries in subscriptions.
+	 */
+	void Subscribe(const Subscription subscriptions[],
+		       size_t numSubscriptions);
+
 
 protected:
+	enum {
+		/*
+		 * The number of hash seeds tried for each table size
+		 * before RebuildDispatchTable() doubles the table.
+		 */
+		MAX_DISPATCH_SEEDS = 64
+	};
+
+	/** Marks the absence of a trie node. */
+	static const size_t NO_NODE = static_cast<size_t>(-1);
+
+	/** A single "name=value" condition of a subscription. */
+	struct Condition
+	{
+		std::string m_name;
+		std::string m_value;
+
+		/** m_value is a prefix rather than the whole value. */
+		bool	    m_prefix;
+	};
+
+	typedef std::vector<Condition> ConditionList;
+
+	/** A parsed Subscription. */
+	struct SubscriptionRule
+	{
+		/** Sorted by name, then in order of precedence. */
+		ConditionList	    m_conditions;
+		Event::BuildMethod *m_buildMethod;
+	};
+
+	typedef std::vector<SubscriptionRule> RuleList;
+
+	/** Subscription rules grouped by event type and system. */
+	typedef std::map<Key, RuleList> SubscriptionMap;
+
+	/**
+	 * A node of a decision trie.  Interior nodes test the value of
+	 * m_field.  Events follow the first matching edge that leads to
+	 * a leaf, or else the m_wildcard edge taken by subscriptions
+	 * without further conditions on m_field.
+	 */
+	struct TrieNode
+	{
+		/** The field tested.  Empty for leaves. */
+		std::string	    m_field;
+
+		/** m_field's EventKey, if it is well known. */
+		EventKey	    m_key;
+
+		/** Index into m_trieEdges of this node's first edge. */
+		size_t		    m_firstEdge;
+		size_t		    m_numEdges;
+		size_t		    m_wildcard;
+
+		/** The build method selected by a leaf. */
+		Event::BuildMethod *m_buildMethod;
+
+		/** Some leaf beneath this node has a build method. */
+		bool		    m_canBuild;
+	};
+
+	/** An edge of a decision trie, taken when a condition holds. */
+	struct TrieEdge
+	{
+		std::string	    m_value;
+		bool		    m_prefix;
+		size_t		    m_child;
+	};
+
+	/** The conditions of a rule that remain to be tested. */
+	struct PendingRule
+	{
+		const SubscriptionRule *m_rule;
+		size_t			m_nextCondition;
+	};
+
+	typedef std::vector<PendingRule> PendingRuleList;
+
+	/** A slot of m_dispatchTable. */
+	struct DispatchEntry
+	{
+		Event::Type         m_type;
+
+		/**
+		 * References the system string of an m_registry or
+		 * m_subscriptions key.
+		 */
+		StringView          m_system;
+
+		/** The registered build method, if any. */
+		Event::BuildMethod *m_buildMethod;
+
+		/** The root of the subscription trie, if any. */
+		size_t		    m_trieRoot;
+	};
+
+	typedef std::vector<DispatchEntry> DispatchTable;
+
+	/**
+	 * Hash an event type and system.
+	 *
+	 * \param seed    Selects one of a family of hash functions.
+	 * \param type    The event type.
+	 * \param system  The system name.
+	 */
+	static size_t Hash(size_t seed, Event::Type type,
+			   const StringView &system);
+
+	/**
+	 * Parse the conditions of a subscription.
+	 *
+	 * \return  The conditions, sorted into the order in which they
+	 *          are tested.
+	 */
+	static ConditionList ParseConditions(const char *conditions);
+
+	/** Order conditions by name and then by precedence. */
+	static bool ConditionPrecedes(const Condition &lhs,
+				      const Condition &rhs);
+
+	static bool ConditionEquals(const Condition &lhs,
+				    const Condition &rhs);
+
+	/**
+	 * Order rules by precedence.  Their conditions are compared in
+	 * turn with ConditionPrecedes(), and a rule ranks ahead of any
+	 * rule whose conditions are a proper prefix of its own.
+	 */
+	static bool RulePrecedes(const SubscriptionRule &lhs,
+				 const SubscriptionRule &rhs);
+
+	/**
+	 * Find the value of a field of an event being built.  Fields
+	 * whose parsing has been deferred are read from the event string.
+	 *
+	 * \param key   The EventKey of name, or NUM_EVENT_KEYS if it
+	 *              is not well known.
+	 * \param name  The name of the field.
+	 */
+	static bool FieldValue(const NVPairMap &nvpairs,
+			       const StringView &eventString, EventKey key,
+			       const StringView &name, StringView &value);
+
+	/**
+	 * \return  The m_dispatchTable entry for type and system, or NULL
+	 *          if there is none.
+	 */
+	const DispatchEntry *Find(Event::Type type,
+				  const StringView &system)		const;
+
+	/**
+	 * Walk the decision trie beneath node.
+	 *
+	 * \param buildMethod  Returns the build method selected by the
+	 *                     matching subscription.  This is NULL if
+	 *                     the subscription rejects the event.
+	 *
+	 * \return  True if a subscription matched.
+	 */
+	bool Match(size_t node, const NVPairMap &nvpairs,
+		   const StringView &eventString,
+		   Event::BuildMethod *&buildMethod)			const;
+
+	/**
+	 * Add the decision trie for a set of rules to m_trieNodes.
+	 *
+	 * \return  The index of the trie's root node.
+	 */
+	size_t CompileTrie(const PendingRuleList &rules);
+
+	/**
+	 * Rebuild m_dispatchTable, and the subscription tries, from
+	 * m_registry and m_subscriptions.  Seeds are tried, and the
+	 * table size doubled when no seed succeeds, until every entry
+	 * hashes to a distinct slot.
+	 */
+	void RebuildDispatchTable();
+
+	/**
+	 * Populate m_dispatchTable using the given size and seed.
+	 *
+	 * \param trieRoots  The trie root of each m_subscriptions entry,
+	 *                   in map order.
+	 *
+	 * \return  False if two entries hash to the same slot.
+	 */
+	bool FillDispatchTable(size_t tableSize, size_t seed,
+			       const std::vector<size_t> &trieRoots);
+
 	/** Registry of event factory methods providing O(log(n)) lookup. */
 	Registry	    m_registry;
 
 	Event::BuildMethod *m_defaultBuildMethod;
+
+	/** Perfect hash of m_registry.  Its size is a power of two. */
+	DispatchTable	    m_dispatchTable;
+
+	/** The seed passed to Hash() for m_dispatchTable. */
+	size_t		    m_dispatchSeed;
+
+	SubscriptionMap	    m_subscriptions;
+
+	/** The nodes of all subscription tries. */
+	std::vector<TrieNode> m_trieNodes;
+
+	/** The edges of all subscription tries. */
+	std::vector<TrieEdge> m_trieEdges;
 };
 
 inline const EventFactory::Registry &
@@ -90,5 +372,38 @@ EventFactory::GetRegistry() const
 	return (m_registry);
 }
 
+inline size_t
+EventFactory::Hash(size_t seed, Event::Type type, const StringView &system)
+{
+	/* FNV-1a, with the seed and type folded into the offset basis. */
+	size_t hash((2166136261U ^ (seed * 0x9e3779b9U)) + type);
+
+	for (StringView::size_type i(0); i < system.length(); i++)
+		hash = (hash ^ (unsigned char)system[i]) * 16777619U;
+	return (hash);
+}
+
+inline const EventFactory::DispatchEntry *
+EventFactory::Find(Event::Type type, const StringView &system) const
+{
+	const DispatchEntry &entry(m_dispatchTable[Hash(m_dispatchSeed, type,
+							system)
+				   & (m_dispatchTable.size() - 1)]);
+
+	if (entry.m_buildMethod == NULL && entry.m_trieRoot == NO_NODE)
+		return (NULL);
+	if (entry.m_type != type || entry.m_system != system)
+		return (NULL);
+	return (&entry);
+}
+
+inline Event::BuildMethod *
+EventFactory::Lookup(Event::Type type, const StringView &system) const
+{
+	const DispatchEntry *entry(Find(type, system));
+
+	return (entry == NULL ? NULL : entry->m_buildMethod);
+}
+
 } // namespace DevCtl
 #endif /*_DEVCTL_EVENT_FACTORY_H_ */
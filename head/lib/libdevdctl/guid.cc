@@ -43,6 +43,7 @@
 #include <limits.h>
 #include <inttypes.h>
 
+#include <cstring>
 #include <iostream>
 #include <string>
 
@@ -69,6 +70,20 @@ Guid::Guid(const string &guidString)
 	}
 }
 
+Guid::Guid(const char *guid, size_t length)
+{
+	/* Enough for any 64-bit value, in any base strtoumax() accepts. */
+	char guidString[72];
+
+	if (length == 0 || length >= sizeof(guidString)) {
+		m_GUID = INVALID_GUID;
+	} else {
+		memcpy(guidString, guid, length);
+		guidString[length] = '\0';
+		m_GUID = (uint64_t)strtoumax(guidString, NULL, 0);
+	}
+}
+
 std::ostream&
 operator<< (std::ostream& out, Guid g)
 {
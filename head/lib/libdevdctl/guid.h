@@ -65,6 +65,7 @@ public:
 	Guid();
 	Guid(uint64_t guid);
 	Guid(const std::string &guid);
+	Guid(const char *guid, size_t length);
 
 	/* Assignment */
 	Guid& operator=(const Guid& rhs);
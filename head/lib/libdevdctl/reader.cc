@@ -36,14 +36,22 @@
 
 #include <sys/cdefs.h>
 #include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
+#include <algorithm>
+#include <cstdarg>
 #include <cstddef>
+#include <cstring>
 #include <errno.h>
+#include <fcntl.h>
 #include <syslog.h>
 #include <unistd.h>
 
 #include <iostream>
+#include <string>
 
+#include "exception.h"
 #include "reader.h"
 
 __FBSDID("$FreeBSD$");
@@ -52,10 +60,39 @@ __FBSDID("$FreeBSD$");
 namespace DevCtl
 {
 
+//- Reader Public Methods -----------------------------------------------------
+bool
+Reader::nonblocking() const
+{
+	return (false);
+}
+
+const char *
+Reader::peek(size_t &count) const
+{
+	count = 0;
+	return (NULL);
+}
+
+void
+Reader::consume(size_t)
+{
+}
+
 //- FDReader Public Methods ---------------------------------------------------
-FDReader::FDReader(int fd)
- : m_fd(fd)
+FDReader::FDReader(int fd, bool nonBlocking)
+ : m_fd(fd),
+   m_nonBlocking(nonBlocking)
 {
+	int flags;
+
+	if (!m_nonBlocking)
+		return;
+
+	flags = fcntl(m_fd, F_GETFL);
+	if (flags == -1 || fcntl(m_fd, F_SETFL, flags | O_NONBLOCK) == -1)
+		throw Exception("FDReader: Unable to set O_NONBLOCK: %s",
+				strerror(errno));
 }
 
 ssize_t
@@ -75,6 +112,12 @@ FDReader::in_avail() const
 	return (bytes);
 }
 
+bool
+FDReader::nonblocking() const
+{
+	return (m_nonBlocking);
+}
+
 //- IstreamReader Inline Public Methods ----------------------------------------
 IstreamReader::IstreamReader(std::istream* stream)
  : m_stream(stream)
@@ -96,4 +139,67 @@ IstreamReader::in_avail() const
 	return (m_stream->rdbuf()->in_avail());
 }
 
+//- MmapReader Public Methods --------------------------------------------------
+MmapReader::MmapReader(int fd)
+ : m_data(NULL),
+   m_size(0),
+   m_offset(0)
+{
+	struct stat sb;
+	void	   *mapping;
+
+	if (fstat(fd, &sb) != 0)
+		throw Exception("MmapReader: fstat failed: %s",
+				strerror(errno));
+	if (!S_ISREG(sb.st_mode))
+		throw Exception("MmapReader: not a regular file");
+	if (sb.st_size == 0)
+		return;
+
+	mapping = mmap(NULL, sb.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (mapping == MAP_FAILED)
+		throw Exception("MmapReader: mmap failed: %s", strerror(errno));
+
+	/* Data is consumed front to back exactly once. */
+	if (madvise(mapping, sb.st_size, MADV_SEQUENTIAL) != 0)
+		syslog(LOG_DEBUG, "MmapReader: madvise: %s", strerror(errno));
+
+	m_data = static_cast<const char *>(mapping);
+	m_size = sb.st_size;
+}
+
+MmapReader::~MmapReader()
+{
+	if (m_data != NULL)
+		munmap(const_cast<char *>(m_data), m_size);
+}
+
+ssize_t
+MmapReader::in_avail() const
+{
+	return (m_size - m_offset);
+}
+
+ssize_t
+MmapReader::read(char* buf, size_t count)
+{
+	count = std::min(count, m_size - m_offset);
+	memcpy(buf, m_data + m_offset, count);
+	m_offset += count;
+	return (count);
+}
+
+const char *
+MmapReader::peek(size_t &count) const
+{
+	count = m_size - m_offset;
+	return (m_data + m_offset);
+}
+
+void
+MmapReader::consume(size_t count)
+{
+	m_offset += std::min(count, m_size - m_offset);
+}
+
 } // namespace DevCtl
@@ -78,6 +78,37 @@ public:
 	 */
 	virtual ssize_t read(char* buf, size_t count) = 0;
 
+	/**
+	 * \brief Report whether this Reader performs non-blocking reads
+	 *
+	 * Consumers of a non-blocking Reader skip in_avail() and simply
+	 * read() until the Reader reports that no data is pending by
+	 * returning -1 with errno set to EAGAIN.  Otherwise, consumers
+	 * must only read() as much data as in_avail() reports.  The
+	 * default implementation returns false.
+	 */
+	virtual bool nonblocking() const;
+
+	/**
+	 * \brief Provide direct access to unread input
+	 *
+	 * Readers whose input is already in memory can hand out a pointer
+	 * to it, allowing consumers to parse the data in place instead of
+	 * copying it with read().  The returned data remains valid for the
+	 * lifetime of the Reader.  The default implementation does not
+	 * support direct access.
+	 *
+	 * \param[out] count  The number of contiguous bytes available.
+	 * \returns  A pointer to the unread input, or NULL if this Reader
+	 *           does not support direct access.
+	 */
+	virtual const char *peek(size_t &count) const;
+
+	/**
+	 * \brief Mark count bytes of the input returned by peek() as read.
+	 */
+	virtual void consume(size_t count);
+
 	virtual ~Reader() = 0;
 };
 
@@ -94,18 +125,27 @@ public:
 	/**
 	 * \brief Constructor
 	 *
-	 * \param fd  An open file descriptor.  It will not be garbage
-	 *            collected by the destructor.
+	 * \param fd           An open file descriptor.  It will not be
+	 *                     garbage collected by the destructor.
+	 * \param nonBlocking  Operate in non-blocking mode.  O_NONBLOCK
+	 *                     is set on fd, and consumers read until
+	 *                     EAGAIN instead of querying in_avail() with
+	 *                     ioctl(FIONREAD) before each read.
 	 */
-	FDReader(int fd);
+	FDReader(int fd, bool nonBlocking = false);
 
 	virtual ssize_t  in_avail() const;
 
 	virtual ssize_t read(char* buf, size_t count);
 
+	virtual bool nonblocking() const;
+
 protected:
 	/** Copy of the underlying file descriptor */
-	int m_fd;
+	int  m_fd;
+
+	/** The Reader operates in non-blocking mode. */
+	bool m_nonBlocking;
 };
 
 /*-------------------------------- IstreamReader------------------------------*/
@@ -132,5 +172,53 @@ protected:
 	std::istream *m_stream;
 };
 
+/*-------------------------------- MmapReader --------------------------------*/
+/**
+ * \brief Specialization of Reader that memory maps a file
+ *
+ * Intended for replaying captured devd event streams.  The whole file is
+ * mapped and served from memory, either by read() or, without copying, by
+ * peek() and consume().
+ */
+class MmapReader : public Reader
+{
+public:
+	/**
+	 * \brief Constructor
+	 *
+	 * \param fd  A file descriptor open on a regular file.  It will not
+	 *            be closed by the destructor, and may be closed as
+	 *            soon as the constructor returns.
+	 *
+	 * \throws Exception if the file cannot be mapped.
+	 */
+	MmapReader(int fd);
+
+	virtual ~MmapReader();
+
+	virtual ssize_t in_avail() const;
+
+	virtual ssize_t read(char* buf, size_t count);
+
+	virtual const char *peek(size_t &count) const;
+
+	virtual void consume(size_t count);
+
+protected:
+	/** The mapping of the file.  NULL for an empty file. */
+	const char *m_data;
+
+	/** The size of the mapping. */
+	size_t	    m_size;
+
+	/** Offset of the first unread byte in the mapping. */
+	size_t	    m_offset;
+
+private:
+	/* Not copyable. */
+	MmapReader(const MmapReader &);
+	MmapReader &operator=(const MmapReader &);
+};
+
 } // namespace DevCtl
 #endif	/* _DEVCTL_READER_H_ */
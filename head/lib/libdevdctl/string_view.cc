@@ -0,0 +1,142 @@
+/*-
+ * Copyright (c) 2012, 2013 Spectra Logic Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions, and the following disclaimer,
+ *    without modification.
+ * 2. Redistributions in binary form must reproduce at minimum a disclaimer
+ *    substantially similar to the "NO WARRANTY" disclaimer below
+ *    ("Disclaimer") and any redistribution must be conditioned upon
+ *    including a substantially similar Disclaimer requirement for further
+ *    binary redistribution.
+ *
+ * NO WARRANTY
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTIBILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDERS OR CONTRIBUTORS BE LIABLE FOR SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGES.
+ *
+ * $FreeBSD$
+ */
+
+/**
+ * \file string_view.cc
+ *
+ * Implementation of the StringView class.
+ */
+#include <sys/cdefs.h>
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+#include "string_view.h"
+
+__FBSDID("$FreeBSD$");
+/*============================ Namespace Control =============================*/
+namespace DevCtl
+{
+
+/*=========================== Class Implementations ==========================*/
+/*-------------------------------- StringView --------------------------------*/
+//- StringView Public Methods --------------------------------------------------
+StringView
+StringView::substr(size_type pos, size_type count) const
+{
+	if (pos > m_length)
+		pos = m_length;
+	return (StringView(m_data + pos, std::min(count, m_length - pos)));
+}
+
+StringView::size_type
+StringView::find(const StringView &s, size_type pos) const
+{
+	if (s.m_length == 0)
+		return (pos <= m_length ? pos : npos);
+
+	while (pos < m_length && m_length - pos >= s.m_length) {
+		const char *first;
+
+		first = static_cast<const char *>(
+		    memchr(m_data + pos, s.m_data[0],
+			   m_length - pos - s.m_length + 1));
+		if (first == NULL)
+			break;
+		pos = first - m_data;
+		if (memcmp(first, s.m_data, s.m_length) == 0)
+			return (pos);
+		pos++;
+	}
+	return (npos);
+}
+
+StringView::size_type
+StringView::find_first_of(const StringView &chars, size_type pos) const
+{
+	for (; pos < m_length; pos++) {
+		if (memchr(chars.m_data, m_data[pos], chars.m_length) != NULL)
+			return (pos);
+	}
+	return (npos);
+}
+
+StringView::size_type
+StringView::find_last_of(const StringView &chars, size_type pos) const
+{
+	if (m_length == 0)
+		return (npos);
+
+	pos = std::min(pos, m_length - 1);
+	do {
+		if (memchr(chars.m_data, m_data[pos], chars.m_length) != NULL)
+			return (pos);
+	} while (pos-- != 0);
+	return (npos);
+}
+
+StringView::size_type
+StringView::find_last_not_of(char c, size_type pos) const
+{
+	if (m_length == 0)
+		return (npos);
+
+	pos = std::min(pos, m_length - 1);
+	do {
+		if (m_data[pos] != c)
+			return (pos);
+	} while (pos-- != 0);
+	return (npos);
+}
+
+int
+StringView::compare(const StringView &rhs) const
+{
+	int result;
+
+	result = memcmp(m_data, rhs.m_data, std::min(m_length, rhs.m_length));
+	if (result != 0)
+		return (result);
+	if (m_length == rhs.m_length)
+		return (0);
+	return (m_length < rhs.m_length ? -1 : 1);
+}
+
+std::ostream&
+operator<< (std::ostream& out, const StringView &view)
+{
+	return (out.write(view.data(), view.length()));
+}
+
+} // namespace DevCtl
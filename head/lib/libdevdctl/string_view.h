@@ -0,0 +1,217 @@
+/*-
+ * Copyright (c) 2012, 2013 Spectra Logic Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions, and the following disclaimer,
+ *    without modification.
+ * 2. Redistributions in binary form must reproduce at minimum a disclaimer
+ *    substantially similar to the "NO WARRANTY" disclaimer below
+ *    ("Disclaimer") and any redistribution must be conditioned upon
+ *    including a substantially similar Disclaimer requirement for further
+ *    binary redistribution.
+ *
+ * NO WARRANTY
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTIBILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDERS OR CONTRIBUTORS BE LIABLE FOR SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGES.
+ *
+ * $FreeBSD$
+ */
+
+/**
+ * \file devctl_string_view.h
+ *
+ * Definition of the StringView class.
+ *
+ * Header requirements:
+ *
+ *    #include <cstring>
+ *    #include <iosfwd>
+ *    #include <string>
+ */
+#ifndef	_DEVCTL_STRING_VIEW_H_
+#define	_DEVCTL_STRING_VIEW_H_
+
+/*============================ Namespace Control =============================*/
+namespace DevCtl
+{
+
+/*============================= Class Definitions ============================*/
+/*-------------------------------- StringView --------------------------------*/
+/**
+ * \brief Non-owning, read-only reference to a run of characters.
+ *
+ * A StringView is a pointer and a length.  It never copies or frees the
+ * characters it references, so it is only valid for as long as the
+ * storage backing it.  The referenced data need not be NUL terminated.
+ *
+ * The method names mirror those of std::string so that parsing code
+ * can operate on either type.
+ */
+class StringView
+{
+public:
+	typedef size_t size_type;
+
+	/** Returned by the search methods when no match is found. */
+	static const size_type npos = static_cast<size_type>(-1);
+
+	/* Constructors */
+	StringView();
+	StringView(const char *data, size_type length);
+	StringView(const char *cString);
+	StringView(const std::string &str);
+
+	/* Accessors */
+	const char *data()					const;
+	size_type   length()					const;
+	size_type   size()					const;
+	bool        empty()					const;
+	char        operator[](size_type pos)			const;
+
+	/**
+	 * \return  A view of at most count characters starting at pos.
+	 */
+	StringView substr(size_type pos, size_type count = npos)	const;
+
+	/** \return  An owned copy of the referenced characters. */
+	std::string str()					const;
+
+	/* Searching.  Semantics match the std::string methods. */
+	size_type find(char c, size_type pos = 0)			const;
+	size_type find(const StringView &s, size_type pos = 0)	const;
+	size_type find_first_of(const StringView &chars,
+				size_type pos = 0)		const;
+	size_type find_last_of(const StringView &chars,
+			       size_type pos = npos)		const;
+	size_type find_last_not_of(char c, size_type pos = npos)	const;
+
+	/**
+	 * Lexicographically compare two views.
+	 *
+	 * \return  <0, 0, or >0 as for memcmp(3).
+	 */
+	int compare(const StringView &rhs)			const;
+
+private:
+	const char *m_data;
+	size_type   m_length;
+};
+
+bool operator==(const StringView &lhs, const StringView &rhs);
+bool operator!=(const StringView &lhs, const StringView &rhs);
+bool operator<(const StringView &lhs, const StringView &rhs);
+std::ostream &operator<<(std::ostream &out, const StringView &view);
+
+//- StringView Inline Public Methods -------------------------------------------
+inline
+StringView::StringView()
+ : m_data(""),
+   m_length(0)
+{
+}
+
+inline
+StringView::StringView(const char *data, size_type length)
+ : m_data(data),
+   m_length(length)
+{
+}
+
+inline
+StringView::StringView(const char *cString)
+ : m_data(cString),
+   m_length(strlen(cString))
+{
+}
+
+inline
+StringView::StringView(const std::string &str)
+ : m_data(str.data()),
+   m_length(str.length())
+{
+}
+
+inline const char *
+StringView::data() const
+{
+	return (m_data);
+}
+
+inline StringView::size_type
+StringView::length() const
+{
+	return (m_length);
+}
+
+inline StringView::size_type
+StringView::size() const
+{
+	return (m_length);
+}
+
+inline bool
+StringView::empty() const
+{
+	return (m_length == 0);
+}
+
+inline char
+StringView::operator[](size_type pos) const
+{
+	return (m_data[pos]);
+}
+
+inline std::string
+StringView::str() const
+{
+	return (std::string(m_data, m_length));
+}
+
+inline StringView::size_type
+StringView::find(char c, size_type pos) const
+{
+	const void *found;
+
+	if (pos >= m_length)
+		return (npos);
+	found = memchr(m_data + pos, c, m_length - pos);
+	if (found == NULL)
+		return (npos);
+	return (static_cast<const char *>(found) - m_data);
+}
+
+//- StringView Inline Operators ------------------------------------------------
+inline bool
+operator==(const StringView &lhs, const StringView &rhs)
+{
+	return (lhs.length() == rhs.length()
+	     && memcmp(lhs.data(), rhs.data(), lhs.length()) == 0);
+}
+
+inline bool
+operator!=(const StringView &lhs, const StringView &rhs)
+{
+	return (!(lhs == rhs));
+}
+
+inline bool
+operator<(const StringView &lhs, const StringView &rhs)
+{
+	return (lhs.compare(rhs) < 0);
+}
+
+} // namespace DevCtl
+#endif	/* _DEVCTL_STRING_VIEW_H_ */